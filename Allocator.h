@@ -17,20 +17,573 @@
 #define DBG(str) do { } while ( false )
 #endif
 
+//with asserts on, every allocate and deallocate checks the blocks it touched
+//and their neighbours, and every ALLOCATOR_CHECK_PERIOD-th one (per thread)
+//walks the whole heap as well; 1 walks it every time, 0 never
+#ifndef ALLOCATOR_CHECK_PERIOD
+#define ALLOCATOR_CHECK_PERIOD 1024
+#endif
+
 // --------
 // includes
 // --------
 
+#include <algorithm> // copy, fill, max, sort
+#include <atomic>    // atomic
 #include <cassert>   // assert
+#include <chrono>    // steady_clock
+#include <cstdint>   // uintptr_t
+#include <cstddef>   // ptrdiff_t, size_t
+#include <functional> // less
+#include <cstdio>    // fopen, fread, fseek, ftell, fwrite
+#include <cstdlib>   // abs
+#include <cstring>   // memcpy
+#include <mutex>     // lock_guard, mutex
 #include <new>       // new
+#include <limits>    // numeric_limits
 #include <stdexcept> // invalid_argument
+#include <type_traits> // conditional, false_type, true_type
+#include <vector>    // vector
+
+#include <sys/mman.h> // madvise, mmap, munmap
+#include <unistd.h>   // sysconf
+
+#if __cplusplus >= 201703L
+#include <memory_resource> // memory_resource
+#endif
+
+// -------
+// Storage
+// -------
+
+/**
+ * where an Allocator keeps its heap: N bytes inside the allocator itself,
+ * aligned for both T and the sentinels, which are Ws
+ */
+template <typename T, std::size_t N, typename W = int>
+class Storage {
+    private:
+        alignas(T) alignas(W) char a[N];
+
+    public:
+        char* data () {
+            return a;}
+
+        const char* data () const {
+            return a;}
+
+        std::size_t size () const {
+            return N;}
+
+        /**
+         * the bytes are part of the allocator, so there's nothing to give back
+         */
+        void release (char*, std::size_t) {}};
+
+/**
+ * for N == 0, a buffer whose size is picked at run time: either one the caller
+ * lends (and keeps), or pages mapped for this allocator alone and unmapped
+ * when it goes away. the default is an empty buffer.
+ * the buffer belongs to one allocator, so it can be moved but not copied.
+ */
+template <typename T, typename W>
+class Storage<T, 0, W> {
+    private:
+        char*       a;
+        std::size_t n;
+        bool        mapped;
+
+    public:
+        Storage () :
+                a      (0),
+                n      (0),
+                mapped (false)
+            {}
+
+        /**
+         * lends p[0, s), trimmed to start aligned for both T and the sentinels
+         */
+        Storage (char* p, std::size_t s) :
+                mapped (false) {
+            const std::size_t alignment = (alignof(T) > alignof(W)) ? alignof(T) : alignof(W);
+            const std::size_t pad       = -reinterpret_cast<std::uintptr_t>(p) & (alignment - 1);
+            a = p + pad;
+            n = (s > pad) ? s - pad : 0;}
+
+        /**
+         * maps s bytes, rounded up to whole pages, straight from the OS.
+         * pages are only backed once touched, so s can be far more than is used.
+         */
+        explicit Storage (std::size_t s) :
+                a      (0),
+                n      (0),
+                mapped (false) {
+            const std::size_t page = sysconf(_SC_PAGESIZE);
+            const std::size_t size = (s + page - 1) / page * page;
+            if ((s == 0) || (size < s))
+                throw std::bad_alloc();
+            void* p = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+            if (p == MAP_FAILED)
+                throw std::bad_alloc();
+            a      = static_cast<char*>(p);
+            n      = size;
+            mapped = true;}
+
+        Storage (Storage&& that) :
+                a      (that.a),
+                n      (that.n),
+                mapped (that.mapped) {
+            that.a      = 0;
+            that.n      = 0;
+            that.mapped = false;}
+
+        Storage             (const Storage&) = delete;
+        Storage& operator = (const Storage&) = delete;
+
+        ~Storage () {
+            if (mapped)
+                munmap(a, n);}
+
+        char* data () {
+            return a;}
+
+        const char* data () const {
+            return a;}
+
+        std::size_t size () const {
+            return n;}
+
+        /**
+         * O(1) in space
+         * O(s) in time, in pages
+         * gives the whole pages of p[0, s) back to the OS; they read as zeros
+         * when next touched. only mapped storage does this.
+         */
+        void release (char* p, std::size_t s) {
+            if (!mapped)
+                return;
+            const std::uintptr_t page  = sysconf(_SC_PAGESIZE);
+            const std::uintptr_t first = (reinterpret_cast<std::uintptr_t>(p) + page - 1) / page * page;
+            const std::uintptr_t last  = (reinterpret_cast<std::uintptr_t>(p) + s) / page * page;
+            if (first < last)
+                madvise(reinterpret_cast<void*>(first), last - first, MADV_DONTNEED);}};
+
+/**
+ * floor(log2(n)), for n > 0, at compile time: the size class of a block of
+ * n bytes, and, of N, the highest one a heap of N bytes can have
+ */
+constexpr int floor_log2 (std::size_t n) {
+    return (n < 2) ? 0 : 1 + floor_log2(n / 2);}
+
+// ---------
+// placement
+// ---------
+
+/**
+ * where Allocator puts a block; each is a tag for its third parameter.
+ * FirstFit takes the first block the free-list index turns up that fits
+ * (see Allocator::find_fit); it's O(1) in the common case.
+ */
+struct FirstFit {
+    static const char* name () {
+        return "FirstFit";}};
+
+/**
+ * NextFit walks the heap in address order from where the last search ended
+ * (a roving pointer) and takes the first block that fits; it's O(n).
+ */
+struct NextFit {
+    static const char* name () {
+        return "NextFit";}};
+
+/**
+ * BestFit takes the smallest indexed block that fits, scanning the bins from
+ * the request's own up to the first that has one; it's O(n) in the worst case.
+ */
+struct BestFit {
+    static const char* name () {
+        return "BestFit";}};
+
+/**
+ * AddressOrderedBestFit is BestFit with ties going to the lowest address,
+ * which keeps long-lived blocks packed at the front of the heap.
+ */
+struct AddressOrderedBestFit {
+    static const char* name () {
+        return "AddressOrderedBestFit";}};
+
+// -----
+// stats
+// -----
+
+/**
+ * what an Allocator's hook is told about
+ */
+enum AllocatorEvent {
+    ALLOCATED,      // p is a new block of bytes
+    DEALLOCATED,    // p was a block of bytes
+    FAILED,         // nothing could hold bytes, and p is 0
+    RESIZED,        // p is now a block of bytes, without having moved
+    RELEASED};      // every block, bytes in all, was freed at once, and p is 0
+
+typedef void (*AllocatorHook) (void* context, AllocatorEvent e, const void* p, long bytes);
+
+/**
+ * a snapshot of an Allocator's counters (see Allocator::stats).
+ * sizes are of blocks, so they include the sentinels' rounding but not the sentinels.
+ */
+struct AllocatorStats {
+    long allocs;
+    long frees;
+    long failures;
+    long bytes_in_use;
+    long high_water;        // the most bytes_in_use has been
+    long free_blocks;       // slivers included
+    long largest_free;
+    long scans;             // free blocks looked at, by all the allocates
+    long max_scan;          // the most looked at by one allocate
+    long sizes[32];         // requests, by floor(log2(bytes)); the last takes any bigger, the first any <= 0
+};
+
+/**
+ * the fourth parameter of Allocator: NoStats keeps nothing, and every call
+ * to it compiles away
+ */
+struct NoStats {
+    static const bool enabled = false;
+
+    static const char* name () {
+        return "NoStats";}
+
+    void probe       () const                        {}
+    void initialized ()                              {}
+    void allocated   (const void*, long, long, long) {}
+    void deallocated (const void*, long, long)       {}
+    void resized     (const void*, long, long, long) {}
+    void failed      (long)                          {}
+    void released    ()                              {}};
+
+/**
+ * Stats counts what NoStats doesn't. the Allocator is the only writer, so the
+ * counters are relaxed atomics bumped with a load and a store, not a locked
+ * add, and another thread can read them (a dashboard, say) without a race.
+ */
+class Stats {
+    private:
+        std::atomic<long> allocs;
+        std::atomic<long> frees;
+        std::atomic<long> failures;
+        std::atomic<long> bytes_in_use;
+        std::atomic<long> high_water;
+        std::atomic<long> free_blocks;
+        std::atomic<long> scans;
+        std::atomic<long> max_scan;
+        std::atomic<long> sizes[32];
+
+        AllocatorHook hook;
+        void*         context;
+
+        /**
+         * free blocks looked at by the allocate in progress
+         */
+        mutable long scan;
+
+        static long get (const std::atomic<long>& c) {
+            return c.load(std::memory_order_relaxed);}
+
+        static void set (std::atomic<long>& c, long v) {
+            c.store(v, std::memory_order_relaxed);}
+
+        static void add (std::atomic<long>& c, long d) {
+            set(c, get(c) + d);}
+
+        void requested (long bytes) {
+            add(sizes[(bytes <= 0) ? 0 : std::min(31, 63 - __builtin_clzll((unsigned long long)bytes))], 1);
+            add(scans, scan);
+            set(max_scan, std::max(get(max_scan), scan));
+            scan = 0;}
+
+    public:
+        static const bool enabled = true;
+
+        static const char* name () {
+            return "Stats";}
+
+        Stats () :
+                hook    (0),
+                context (0),
+                scan    (0) {
+            set(allocs,       0);
+            set(frees,        0);
+            set(failures,     0);
+            set(bytes_in_use, 0);
+            set(high_water,   0);
+            set(free_blocks,  0);
+            set(scans,        0);
+            set(max_scan,     0);
+            for (int k = 0; k != 32; ++k)
+                set(sizes[k], 0);}
+
+        /**
+         * a copy of an Allocator has the same counters, and the same hook
+         */
+        Stats (const Stats& that) :
+                hook    (that.hook),
+                context (that.context),
+                scan    (0) {
+            *this = that;}
+
+        Stats& operator = (const Stats& that) {
+            set(allocs,       get(that.allocs));
+            set(frees,        get(that.frees));
+            set(failures,     get(that.failures));
+            set(bytes_in_use, get(that.bytes_in_use));
+            set(high_water,   get(that.high_water));
+            set(free_blocks,  get(that.free_blocks));
+            set(scans,        get(that.scans));
+            set(max_scan,     get(that.max_scan));
+            for (int k = 0; k != 32; ++k)
+                set(sizes[k], get(that.sizes[k]));
+            hook    = that.hook;
+            context = that.context;
+            return *this;}
+
+        /**
+         * called on every free block an allocate looks at
+         */
+        void probe () const {
+            ++scan;}
+
+        /**
+         * the heap is one free block
+         */
+        void initialized () {
+            set(free_blocks, 1);}
+
+        /**
+         * p is a block of bytes, given out for a request of requested bytes;
+         * free_delta free blocks came (from padding and splitting) or went
+         */
+        void allocated (const void* p, long requested_bytes, long bytes, long free_delta) {
+            requested(requested_bytes);
+            add(allocs, 1);
+            add(bytes_in_use, bytes);
+            add(free_blocks, free_delta);
+            set(high_water, std::max(get(high_water), get(bytes_in_use)));
+            if (hook != 0)
+                hook(context, ALLOCATED, p, bytes);}
+
+        void deallocated (const void* p, long bytes, long free_delta) {
+            add(frees, 1);
+            add(bytes_in_use, -bytes);
+            add(free_blocks, free_delta);
+            if (hook != 0)
+                hook(context, DEALLOCATED, p, bytes);}
+
+        /**
+         * p grew or shrank in place from old_bytes to bytes
+         */
+        void resized (const void* p, long old_bytes, long bytes, long free_delta) {
+            add(bytes_in_use, bytes - old_bytes);
+            add(free_blocks, free_delta);
+            set(high_water, std::max(get(high_water), get(bytes_in_use)));
+            if (hook != 0)
+                hook(context, RESIZED, p, bytes);}
+
+        void failed (long requested_bytes) {
+            requested(requested_bytes);
+            add(failures, 1);
+            if (hook != 0)
+                hook(context, FAILED, 0, requested_bytes);}
+
+        /**
+         * every block is free again (followed by initialized)
+         */
+        void released () {
+            const long bytes = get(bytes_in_use);
+            set(bytes_in_use, 0);
+            if (hook != 0)
+                hook(context, RELEASED, 0, bytes);}
+
+        void set_hook (AllocatorHook f, void* c) {
+            hook    = f;
+            context = c;}
+
+        /**
+         * every counter but largest_free, which only the heap knows
+         */
+        AllocatorStats snapshot () const {
+            AllocatorStats s;
+            s.allocs       = get(allocs);
+            s.frees        = get(frees);
+            s.failures     = get(failures);
+            s.bytes_in_use = get(bytes_in_use);
+            s.high_water   = get(high_water);
+            s.free_blocks  = get(free_blocks);
+            s.largest_free = 0;
+            s.scans        = get(scans);
+            s.max_scan     = get(max_scan);
+            for (int k = 0; k != 32; ++k)
+                s.sizes[k] = get(sizes[k]);
+            return s;}};
+
+// -----
+// trace
+// -----
+
+/**
+ * one event of a trace, as TraceRecorder keeps and saves it (native-endian)
+ */
+struct TraceRecord {
+    std::uint64_t nanos;    // since the recorder was made
+    std::uint64_t id;       // the block's address less the recorder's base, or 0 if p is 0
+    std::uint64_t bytes;    // of the block (see AllocatorEvent)
+    std::uint64_t op;};     // an AllocatorEvent; 64 bits, so there's no padding
+
+/**
+ * what a saved trace starts with; count records follow, oldest first
+ */
+struct TraceHeader {
+    char          magic[4]; // "ATR1"
+    std::uint32_t record_size;
+    std::uint64_t count;
+    std::uint64_t dropped;  // older records the ring had no room for
+};
+
+/**
+ * TraceRecorder is a hook for an Allocator<T, N, P, Stats> that keeps the
+ * last capacity events in a ring allocated up front, so recording never
+ * allocates; once the ring is full each new event overwrites the oldest.
+ * a block's id is its address less base, so base should be below every
+ * block (the Allocator itself, for N != 0) to keep ids small and never 0.
+ *     TraceRecorder r(1 << 20, &x);
+ *     x.hook(TraceRecorder::record, &r);
+ *     ...
+ *     r.save("x.trace");
+ */
+class TraceRecorder {
+    private:
+        std::vector<TraceRecord>              ring;
+        std::size_t                           next;     // where the next record goes
+        std::size_t                           count;
+        std::uint64_t                         lost;
+        std::uintptr_t                        base;
+        std::chrono::steady_clock::time_point start;
+
+    public:
+        /**
+         * O(capacity) in space / O(1) in time
+         */
+        explicit TraceRecorder (std::size_t capacity, const void* base = 0) :
+                ring  (capacity),
+                next  (0),
+                count (0),
+                lost  (0),
+                base  (reinterpret_cast<std::uintptr_t>(base)),
+                start (std::chrono::steady_clock::now()) {
+            if (capacity == 0)
+                throw std::invalid_argument("TraceRecorder::TraceRecorder");}
+
+        /**
+         * an AllocatorHook; context is the TraceRecorder
+         */
+        static void record (void* context, AllocatorEvent e, const void* p, long bytes) {
+            static_cast<TraceRecorder*>(context)->add(e, p, bytes);}
+
+        /**
+         * O(1) in space / O(1) in time
+         */
+        void add (AllocatorEvent e, const void* p, long bytes) {
+            TraceRecord& r = ring[next];
+            r.nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                          std::chrono::steady_clock::now() - start).count();
+            r.id    = (p == 0) ? 0 : reinterpret_cast<std::uintptr_t>(p) - base;
+            r.bytes = static_cast<std::uint64_t>(bytes);
+            r.op    = e;
+            if (++next == ring.size())
+                next = 0;
+            if (count == ring.size())
+                ++lost;
+            else
+                ++count;}
+
+        /**
+         * O(1) in space / O(1) in time
+         * the ith oldest record kept
+         */
+        const TraceRecord& operator [] (std::size_t i) const {
+            assert(i < count);
+            return ring[(next + ring.size() - count + i) % ring.size()];}
+
+        std::size_t size () const {
+            return count;}
+
+        std::size_t capacity () const {
+            return ring.size();}
+
+        std::uint64_t dropped () const {
+            return lost;}
+
+        void clear () {
+            next  = 0;
+            count = 0;
+            lost  = 0;}
+
+        /**
+         * O(1) in space / O(n) in time
+         * writes a TraceHeader and the records kept, oldest first
+         */
+        bool save (const char* path) const {
+            std::FILE* f = std::fopen(path, "wb");
+            if (f == 0)
+                return false;
+            const TraceHeader h = {{'A', 'T', 'R', '1'}, sizeof(TraceRecord), count, lost};
+            bool b = std::fwrite(&h, sizeof(h), 1, f) == 1;
+            const std::size_t first = (next + ring.size() - count) % ring.size();
+            const std::size_t run   = std::min(count, ring.size() - first);
+            b = b && std::fwrite(&ring[first], sizeof(TraceRecord), run,         f) == run;
+            b = b && std::fwrite(&ring[0],     sizeof(TraceRecord), count - run, f) == count - run;
+            return (std::fclose(f) == 0) && b;}
+
+        /**
+         * O(n) in space / O(n) in time
+         * reads what save wrote into v, and its header into h; fails, leaving
+         * v empty, if the header claims more records than the file holds, or
+         * if they can't all be read
+         */
+        static bool load (const char* path, std::vector<TraceRecord>& v, TraceHeader& h) {
+            v.clear();
+            std::FILE* f = std::fopen(path, "rb");
+            if (f == 0)
+                return false;
+            bool b = (std::fread(&h, sizeof(h), 1, f) == 1)         &&
+                     (std::memcmp(h.magic, "ATR1", 4) == 0)          &&
+                     (h.record_size == sizeof(TraceRecord));
+            if (b) {
+                const long here = std::ftell(f);
+                b = (here >= 0) && (std::fseek(f, 0, SEEK_END) == 0);
+                const long end  = b ? std::ftell(f) : -1;
+                b = b && (end >= here) && (std::fseek(f, here, SEEK_SET) == 0) &&
+                    (h.count <= std::uint64_t(end - here) / sizeof(TraceRecord));}
+            if (b) {
+                v.resize(h.count);
+                b = std::fread(v.data(), sizeof(TraceRecord), v.size(), f) == v.size();}
+            std::fclose(f);
+            if (!b)
+                v.clear();
+            return b;}};
 
 // ---------
 // Allocator
 // ---------
 
-template <typename T, int N>
-class Allocator {
+/**
+ * a heap of N bytes, or, for N == 0, of a size picked at run time,
+ * placing blocks by policy P (see placement) and counting with S (see stats).
+ * S is a private base, so that NoStats takes no room.
+ */
+template <typename T, int N, typename P = FirstFit, typename S = NoStats>
+class Allocator : private S {
     public:
         // --------
         // typedefs
@@ -52,8 +605,12 @@ class Allocator {
         // operator ==
         // -----------
 
-        friend bool operator == (const Allocator&, const Allocator&) {
-            return true;}
+        /**
+         * every Allocator is a heap of its own, so only an allocator is
+         * equal to itself (a block from one can't be freed into another)
+         */
+        friend bool operator == (const Allocator& lhs, const Allocator& rhs) {
+            return &lhs == &rhs;}
 
         // -----------
         // operator !=
@@ -67,324 +624,2859 @@ class Allocator {
         // data
         // ----
 
-        char a[N];
+        /**
+         * the segregated free-list index.
+         * bins[k] holds the offset (into a) of the left sentinel of the first
+         * free block whose size is in [2^k, 2^(k+1)), or -1 if that bin is empty.
+         * bit k of bin_map is set iff bins[k] is not empty.
+         * the links themselves live in the payload of the free blocks, so the
+         * index is made of offsets and survives the default copy.
+         * store is aligned for both T and the sentinels.
+         * a heap of N bytes has no block in a bin past floor(log2(N)), so it
+         * only has that many bins (see classes).
+         */
+        Storage<T, N> store;
+        size_type bins[(N == 0) ? 8 * sizeof(size_type) : floor_log2(N) + 1];
+        unsigned  bin_map;
 
-        // -----
-        // valid
-        // -----
+        /**
+         * the roving pointer: the offset of the block after the last one
+         * given out, where NextFit starts its walk. it's always the left
+         * sentinel of some block.
+         */
+        size_type rover;
 
         /**
-         * O(1) in space
-         * O(n) in time
-         * Checks whether or not the "heap" array is valid. 
-		 * It checks if the sentinels match (in value and sign).
-		 * On a mismatch, it returns false.
+         * the stats, if S keeps any
          */
-        bool valid () const {
-           DBG(std::endl << "valid() -- starting...");
-           DBG("valid() -- N = " << N);
-           DBG("valid() -- a[0] = " << (int)a[0]);
-           DBG("valid() -- a[N-4] = " << (int)a[N-4]); 
-			
-//            char *p = const_cast<char*>(reinterpret_cast<const char*>(&a));
-            size_type left, right;
-            int i = 0;
-			
-            while(i < N-(int)sizeof(size_type)) {
-                left = (int)*const_cast<int*>(reinterpret_cast<const int*>(a+i)); //get the sentinel value
-                DBG("valid() --  left: " << left);
-                if(left < 0)	//if the block is busy
-                    right = (int)*const_cast<int*>(reinterpret_cast<const int*>(a + i + (-1*left) + sizeof(size_type)));
-                else			//if the block is free
-                    right = (int)*const_cast<int*>(reinterpret_cast<const int*>(a + i + left + sizeof(size_type)));
-                DBG("valid() -- right: " << right);
-                DBG("valid() --     i: " << i);
+        S& counters () {
+            return *this;}
 
-                if(left != right)
-                    return false;
-                
-                i += std::abs(left) + 2*sizeof(size_type);
-                DBG("valid() -- i at the end of while: " << i);
-            }
-			
-			
-			assert(i == N);
-            // if(i != N) {
-                // DBG("valid() -- i: " << i << "; N: " << N);
-                // return false;
-            // }
-            return true;}
+        const S& counters () const {
+            return *this;}
 
-    public:
-        // ------------
-        // constructors
-        // ------------
+        // -----
+        // sizes
+        // -----
 
         /**
-         * O(1) in space
-         * O(1) in time
-         * Initializes the "heap" array with sentinels on both ends of the array.
-		 * The sentinel values (int) indicate the number of blocks that are in between the two sentinels. 
-		 * The sign of these sentinel values dictate the status of these blocks:
-		 * 		positive value indicates the block is free to be given out,
-		 * 		negative value indicates the block is has been given out to some other requestor.
-		 * Throws bad_alloc if the user tries to create a heap with size that is smaller than
-		 * the size of two int sentinels.
+         * the size of one sentinel
          */
-         
-        Allocator () {
-			if(N < 2*sizeof(size_type)) {
-				throw std::bad_alloc();
-			}
-            int* p1 = reinterpret_cast<int*>(&a[0]);
-            *p1 = (N-2*(sizeof(size_type)));
-            int* p2 = reinterpret_cast<int*>(&a[N-sizeof(size_type)]);
-            *p2 = (N-2*(sizeof(size_type)));
-            assert(valid());}
+        static constexpr size_type header () {
+            return sizeof(size_type);}
 
-        // Default copy, destructor, and copy assignment
-        //Allocator  (const Allocator<T>&);
-        //~Allocator ();
-        //Allocator& operator = (const Allocator&);
+        /**
+         * the smallest payload that can hold the two free-list links.
+         * free blocks smaller than this ("slivers") stay out of the index.
+         */
+        static constexpr size_type min_payload () {
+            return 2 * sizeof(size_type);}
 
-        // --------
-        // allocate
-        // --------
+        /**
+         * the number of size classes (bins): one per power of two up to the heap
+         */
+        static constexpr int classes () {
+            return sizeof(bins) / sizeof(bins[0]);}
 
         /**
-         * O(1) in space
-         * O(n) in time
-         * allocates the requested amount of space to give out to the user.
-	 * returns the pointer to the first element of the block given out.
-	 * gives out extra space if the space that is to be left over can't 
-	 * be used once this block is allocated. otherwise, gives out exactly
-	 * how much was asked for. 
-	 * throws bad_alloc if there is no space to be given out. 
-         * after allocation there must be enough space left for a valid block
-         * the smallest allowable block is sizeof(T) + (2 * sizeof(int))
-         * choose the first block that fits
+         * what a block's size is rounded up to: a whole sentinel, so that the
+         * sentinels and links stay int-aligned, and a multiple of alignof(T)
+         * up to two sentinels, so that a block that follows an aligned block
+         * (two sentinels on) is aligned as well
          */
-		 
-        pointer allocate (size_type n) {
-			DBG("allocate() -- in allocate()... ");
-			//return 0 if the user requests... well, 0 bytes. undefined behavior.
-			if(n == 0)
-				return 0;
-			
-			//traverse through the heap to find a free block
-			char *p = const_cast<char*>(reinterpret_cast<const char*>(&a));
-            size_type left;
-			size_type bytes_needed = n * sizeof(value_type);
-			DBG("allocate() -- bytes_needed: " << bytes_needed);
-			
-            int i = 0;
-			
-            while(i < N-(int)sizeof(size_type)) {
-				left = (int)*reinterpret_cast<int*>(p+i); //get the sentinel value
-				
-				//if a free block is found, check the value.
-				//if value is more than n but less than n+(size of 2 sentinels), give away the whole damn thing
-				//if value is more than n+(size of 2 sentinels), just give out how much was requested
-				//else, pass to the next block
-				DBG("allocate() left: " << left);
-                if(left >= bytes_needed) {	//if the block is free && big enough for allocation
-					DBG("allocate() -- left+2*(int)sizeof(size_type) - (bytes_needed + 2*(int)sizeof(size_type) = " << left+2*(int)sizeof(size_type) << " - (" << bytes_needed << " + 2*" << (int)sizeof(size_type) << ")");
-					DBG("allocate() --  = " << (left+2*(int)sizeof(size_type) - (bytes_needed + 2*(int)sizeof(size_type))));
-					if(left+2*(int)sizeof(size_type) - (bytes_needed + 2*(int)sizeof(size_type)) <=  2*(int)sizeof(size_type)) {	
-						//if the block is less than n+(size of 2 sentinels)
-						//give the whole damn thing away!						
-						//allocate the block in the internal "heap"
-						//since we're not making a new block, just change the sign of the sentinels to negative value
-						
-						int* p1 = reinterpret_cast<int*>(&a[i]);
-						*p1 *= -1;
-						p1 = reinterpret_cast<int*>(&a[i] + left + sizeof(size_type));
-						*p1 *= -1;
-						
-						DBG("allocate() -- allocated with extras");
-						return reinterpret_cast<pointer>(a+i+sizeof(size_type));
-					}
-					else {	
-						//if the block has enough space to allocate more after allocating this block
-						//give out how much was requested
-						//first change the left-sentinel to a new negative value (bytes_needed) 
-						//then move sizeof(size_type)+bytes_needed indices to the right and create a new right-sentinel w/ same value as above
-						//then make a new left-sentinel to the right of the one above with positive value of:
-						//		(original sentinal value - bytes_needed - 2*sizeof(size_type))
-						//then change the original right-sentinel to the same value as above
-						
-						int* p1 = reinterpret_cast<int*>(&a[i]);
-						*p1 = -1*bytes_needed;
-						p1 = reinterpret_cast<int*>(a + i + bytes_needed + sizeof(size_type));
-						*p1 = -1*bytes_needed;
-						++p1;
-						*p1 = (left - bytes_needed - 2*sizeof(size_type));
-						p1 = reinterpret_cast<int*>(a + i + left + sizeof(size_type));
-						*p1 = (left - bytes_needed - 2*sizeof(size_type));
-						
-						DBG("allocate() -- allocated just enough");
-						DBG("allocate() -- a[0] = " << (int)*a);
-						DBG("allocate() -- a[8] = " << (int)*(a+8));
-						DBG("allocate() -- a[12] = " << (int)*(a+12));
-						return reinterpret_cast<pointer>(a+i+sizeof(size_type));						
-					}
-				}
-                //if the block is busy, just skip
-				//skip to the next left-sentinel (no need to check right-sentinels)
-				DBG("allocate() -- i before end of while: " << i);
-				i += std::abs(left) + 2*sizeof(size_type);
-				DBG("allocate() -- i at the end of while: " << i);
-			}
-			
-            assert(valid());
-			
-			//if there is no free block available, throw bad_alloc
-			DBG("allocate() -- throwing party in allocate()");
-			throw std::bad_alloc();
-            
-			return reinterpret_cast<pointer>(a+i+sizeof(size_type));}
+        static constexpr size_type granule () {
+            return (alignof(value_type) < sizeof(size_type))     ? sizeof(size_type) :
+                   (alignof(value_type) > 2 * sizeof(size_type)) ? 2 * sizeof(size_type) : alignof(value_type);}
 
-        // ---------
-        // construct
-        // ---------
+        /**
+         * the usable end of the heap: its size rounded down to a whole sentinel,
+         * so that the last sentinel is int-aligned too
+         */
+        size_type extent () const {
+            return (size_type)(store.size() / header() * header());}
 
         /**
          * O(1) in space
          * O(1) in time
-         * constructs an allocator at pointer p.
+         * the number of bytes needed to move the payload of the free block at
+         * offset i up to a multiple of alignment. a gap is turned into a free
+         * block of its own, so it is either 0 or big enough for two sentinels.
          */
-        void construct (pointer p, const_reference v) {
-			DBG("construct() -- constructin a sentry");
-            new (p) T(v);                            // uncomment!
-            assert(valid());}
+        size_type padding (size_type i, size_type alignment) const {
+            size_type pad = -reinterpret_cast<std::uintptr_t>(base() + i + header()) & (alignment - 1);
+            if ((pad != 0) && (pad < 2 * header()))
+                pad += alignment;
+            return pad;}
 
-        // ----------
-        // deallocate
-        // ----------
+        /**
+         * O(1) in space
+         * O(1) in time
+         * whether the free block at offset i can hold bytes at alignment
+         */
+        bool fits (size_type i, size_type bytes, size_type alignment) const {
+            counters().probe();
+            return tag(i) >= bytes + padding(i, alignment);}
 
         /**
          * O(1) in space
          * O(1) in time
-         * deallocates the block pointed by the argument p. 
-	 * frees up the block to be used by other requests; if there
-	 * are any free blocks adjacent to the block that was just 
-	 * freed, then those blocks are merged with the block that is
-	 * currently being deallocated. 
-         * after deallocation adjacent free blocks must be coalesced
+         * the bin of a free block of size s: floor(log2(s))
          */
-        void deallocate (pointer p, size_type = 0) {
-			DBG("deallocate() -- in deallocate()...");
-            //get the sentinel value (assert them being negative? is it user error?)
-			//turn them into positive values 
-			//check neighboring sentinels:
-			//	if positive, then merge
-			//	if negative, then ignore
-			char* lp = const_cast<char*>(reinterpret_cast<const char*>(p)-4); //pointer to the sentinel
-			char* rp;
-			int* d1 = reinterpret_cast<int*>(lp); //pointer to the sentinel
-			DBG("deallocate() -- left before: " << *d1);
-            *d1 *= -1;
-			DBG("deallocate() -- left after : " << *d1);
-			d1 = reinterpret_cast<int*>(lp + *d1 + sizeof(size_type));
-			DBG("deallocate() -- right before: " << *d1);
-			*d1 *= -1;
-			DBG("deallocate() -- right after : " << *d1);
-			rp = reinterpret_cast<char*>(d1); //pointer to the right sentinel
-			
-			DBG("deallocate() -- *lp: " << (int)*lp);
-			DBG("deallocate() -- *rp: " << (int)*rp);
-			assert(*lp == *rp);
-			
-			int total_bytes = *d1;
-			bool merged = false;
-			
-			//check neighbors
-			//ignore the left if the block to be deallocated is the first block in the heap
-			DBG("deallocate() -- total_bytes (before merges)= " << total_bytes);
-			if(reinterpret_cast<char*>(lp) != a) {	//compare pointers
-				DBG("deallocate() -- sentinel to the left: " << (int)*(lp-sizeof(size_type)));
-				if(*(lp - sizeof(size_type)) > 0) {	//if block left of this one is free
-					//add the total bytes (plus the 2 sentinels in between)
-					total_bytes += (int)*(reinterpret_cast<char*>(lp) - sizeof(size_type)) + 2*sizeof(size_type);
-					//change the pointer (bytes of the block to the left + 2 pointer sizes)
-					lp -= *(lp - sizeof(size_type)) + 2*sizeof(size_type);
-					
-					DBG("deallocate() -- total_bytes (after left merge)= " << total_bytes);
-					//checks if blocks on both sides are free. could've been taken out into its own
-					//if statement, but this requires less computation if both sides are actually free
-					if(reinterpret_cast<char*>(d1) != &a[N]-sizeof(size_type)) {	//compare pointers
-						DBG("deallocate() -- sentinel to the right: " << (int)*(reinterpret_cast<char*>(d1) + sizeof(size_type)));
-						if(*(d1 + 1) > 0) {
-							//add the total bytes (plus the 2 sentinels in between)
-							DBG("deallocate() -- *(d1+1) = " << (int) *(d1+1));
-							total_bytes += *(d1+1) + 2*sizeof(size_type);
-							DBG("deallocate() -- total_bytes (after both merge)= " << total_bytes);
-							//change the pointer (bytes of the block to the right + 2 pointer sizes)
-							rp = reinterpret_cast<char*>(d1);
-							rp += *(rp + sizeof(size_type)) + 2*sizeof(size_type);
-							merged = true;
-						}
-					}
-				}
-			}
-			//at this point, the value that *d holds is the number of free bytes 
-			//(d points to the left-sentinel of the block, whether it merged or not)
-
-			//if both sides have been merged already, skip this
-			if(!merged) {
-				//ignore the right if the block to be deallocated is the last block in the heap
-				if(reinterpret_cast<char*>(d1) != &a[N]-sizeof(size_type)) {	//compare pointers
-					DBG("deallocate() -- sentinel to the right (only): " << (int)*(reinterpret_cast<char*>(d1) + sizeof(size_type)));
-					if((int)*(rp + sizeof(size_type)) > 0) {
-						DBG("deallocate() -- *(d1 + sizeof(size_type)) = " << (int)*(rp + sizeof(size_type)));
-						//add the total bytes (plus the 2 sentinels in between)
-						DBG("deallocate() -- total_bytes (before right-only merge)= " << total_bytes);
-						total_bytes += (int)*reinterpret_cast<int*>(reinterpret_cast<char*>(d1) + sizeof(size_type)) + 2*sizeof(size_type);
-						DBG("deallocate() -- total_bytes (after right-only merge)= " << total_bytes);
-						DBG("deallocate() -- total_bytes: " << total_bytes);
-						//change the pointer (bytes of the block to the right + 2 pointer sizes)
-						rp = reinterpret_cast<char*>(d1);
-						rp += (int)*(rp + sizeof(size_type)) + 2*sizeof(size_type);
-						DBG("deallocate() -- *rp: " << (int)*rp);
-					}
-				}
-				//else
-				//	total_bytes += sizeof(size_type);
-			}
-			
-			//change the values on both sentinels
-			DBG("deallocate() -- total_bytes (before setting)= " << total_bytes);
-			int* lpi = reinterpret_cast<int*>(lp);
-			int* rpi = reinterpret_cast<int*>(rp);
-			
-			DBG("deallocate() -- before setting lp: " << (int)*lpi);
-			*lpi = total_bytes;
-			DBG("deallocate() -- after setting lp: " << (int)*lpi);
-			*rpi = total_bytes;
-			DBG("deallocate() -- after setting rp: " << (int)*rpi);
-			assert(*lpi == *rpi);
-			
-			DBG("deallocate() -- a[0]: " << (int)a[0]);
-			DBG("deallocate() -- a[N-4]: " << (int)a[N-4]);
-			
-            assert(valid());
-			DBG("deallocate() -- passed valid()");
-			}
+        static int bin_of (size_type s) {
+            assert(s > 0);
+            return 8 * sizeof(unsigned) - 1 - __builtin_clz(s);}
 
-        // -------
-        // destroy
-        // -------
+        // ------
+        // access
+        // ------
+
+        /**
+         * the first byte of the heap
+         */
+        char* base () {
+            return store.data();}
+
+        const char* base () const {
+            return store.data();}
+
+        /**
+         * the sentinel at offset i
+         */
+        size_type& tag (size_type i) {
+            return *reinterpret_cast<size_type*>(base() + i);}
+
+        size_type tag (size_type i) const {
+            return *reinterpret_cast<const size_type*>(base() + i);}
+
+        /**
+         * the offset of the left sentinel of the block given out at p
+         */
+        size_type offset_of (const_pointer p) const {
+            return reinterpret_cast<const char*>(p) - base() - header();}
+
+        /**
+         * the free-list links, stored in the payload of the free block at offset i
+         */
+        size_type& next_of (size_type i) {
+            return *reinterpret_cast<size_type*>(base() + i + header());}
+
+        size_type& prev_of (size_type i) {
+            return *reinterpret_cast<size_type*>(base() + i + 2 * header());}
+
+        size_type next_of (size_type i) const {
+            return *reinterpret_cast<const size_type*>(base() + i + header());}
+
+        size_type prev_of (size_type i) const {
+            return *reinterpret_cast<const size_type*>(base() + i + 2 * header());}
 
         /**
          * O(1) in space
          * O(1) in time
-         * destroys the allocator at pointer p.
+         * writes v into both sentinels of the block at offset i
+         */
+        void set_tags (size_type i, size_type v) {
+            tag(i) = v;
+            tag(i + std::abs(v) + header()) = v;}
+
+        // ---------
+        // free list
+        // ---------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * pushes the free block at offset i onto the front of its bin.
+         * slivers can't hold the links, so they are left out of the index.
+         */
+        void link (size_type i) {
+            const size_type s = tag(i);
+            if (s < min_payload())
+                return;
+            const int k = bin_of(s);
+            next_of(i) = bins[k];
+            prev_of(i) = -1;
+            if (bins[k] != -1)
+                prev_of(bins[k]) = i;
+            bins[k]  = i;
+            bin_map |= 1u << k;}
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * removes the free block at offset i from its bin.
+         */
+        void unlink (size_type i) {
+            const size_type s = tag(i);
+            if (s < min_payload())
+                return;
+            const int       k = bin_of(s);
+            const size_type n = next_of(i);
+            const size_type p = prev_of(i);
+            if (p != -1)
+                next_of(p) = n;
+            else
+                bins[k] = n;
+            if (n != -1)
+                prev_of(n) = p;
+            if (bins[k] == -1)
+                bin_map &= ~(1u << k);}
+
+        /**
+         * O(1) in space
+         * O(n) in time
+         * returns the offset of the first free block in [from, to), in address
+         * order, that can hold bytes at alignment, or -1.
+         */
+        size_type walk_fit (size_type bytes, size_type alignment, size_type from, size_type to) const {
+            for (size_type i = from; i < to; i += std::abs(tag(i)) + 2 * header())
+                if ((tag(i) >= 0) && fits(i, bytes, alignment))
+                    return i;
+            return -1;}
+
+        /**
+         * O(1) in space
+         * O(1) in time, except when only the request's own bin can serve it
+         * returns the offset of a free block that can hold bytes at alignment, or -1.
+         * a request past the last bin is bigger than the heap, and fails at once.
+         * the head of the request's own bin is taken if it fits; otherwise the
+         * head of the lowest non-empty bin above it that fits, found from the
+         * bitmap (without padding, any of them does); the rest of the request's
+         * own bin holds blocks that may be too small and is only scanned after that.
+         * padding can make a block miss, but never one of bytes + alignment +
+         * 2*header() or more (see padding), so, for a padded request, the heads
+         * of the bins past that size always fit, and only the lists of the bins
+         * in between are left to scan. slivers are not in the index, so a
+         * request small enough for one falls back to walking the heap before
+         * giving up.
+         */
+        size_type find_fit (size_type bytes, size_type alignment, FirstFit) const {
+            const int k     = bin_of(bytes);
+            if (k >= classes())
+                return -1;
+            unsigned  above = (k + 1 < (int)(8 * sizeof(unsigned))) ? (bin_map & (~0u << (k + 1))) : 0;
+            if ((bins[k] != -1) && fits(bins[k], bytes, alignment))
+                return bins[k];
+            for (; above != 0; above &= above - 1)
+                if (fits(bins[__builtin_ctz(above)], bytes, alignment))
+                    return bins[__builtin_ctz(above)];
+            for (size_type i = bins[k]; i != -1; i = next_of(i))
+                if (fits(i, bytes, alignment))
+                    return i;
+            if (alignment > header()) {
+                const int top = std::min(bin_of(bytes + alignment + 2*header()), classes() - 1);
+                for (int j = k + 1; j <= top; ++j)
+                    for (size_type i = (bins[j] == -1) ? -1 : next_of(bins[j]); i != -1; i = next_of(i))
+                        if (fits(i, bytes, alignment))
+                            return i;}
+            if (bytes >= min_payload())
+                return -1;
+            return walk_fit(bytes, alignment, 0, extent());}
+
+        /**
+         * O(1) in space
+         * O(n) in time
+         * the first free block that fits at or after the rover, wrapping around
+         */
+        size_type find_fit (size_type bytes, size_type alignment, NextFit) const {
+            const size_type i = walk_fit(bytes, alignment, rover, extent());
+            return (i != -1) ? i : walk_fit(bytes, alignment, 0, rover);}
+
+        /**
+         * O(1) in space
+         * O(n) in time
+         * the smallest indexed block that fits; within a bin, ties go to the
+         * first one in the list, or, if by_address, to the lowest address.
+         * every block in a bin is smaller than every block in the bins above,
+         * so the first bin with a fit has the best one. every indexed block
+         * that could fit is looked at, padded request or not, so slivers are
+         * only walked for as a last resort, as in FirstFit.
+         */
+        size_type best_fit (size_type bytes, size_type alignment, bool by_address) const {
+            const int k         = bin_of(bytes);
+            unsigned  bins_left = bin_map & (~0u << k);
+            for (; bins_left != 0; bins_left &= bins_left - 1) {
+                size_type best = -1;
+                for (size_type i = bins[__builtin_ctz(bins_left)]; i != -1; i = next_of(i))
+                    if (fits(i, bytes, alignment) &&
+                        ((best == -1) || (tag(i) < tag(best)) || (by_address && (tag(i) == tag(best)) && (i < best))))
+                        best = i;
+                if (best != -1)
+                    return best;}
+            if (bytes >= min_payload())
+                return -1;
+            return walk_fit(bytes, alignment, 0, extent());}
+
+        size_type find_fit (size_type bytes, size_type alignment, BestFit) const {
+            return best_fit(bytes, alignment, false);}
+
+        size_type find_fit (size_type bytes, size_type alignment, AddressOrderedBestFit) const {
+            return best_fit(bytes, alignment, true);}
+
+        // -----
+        // valid
+        // -----
+
+        /**
+         * O(1) in space
+         * O(n) in time
+         * Checks whether or not the "heap" array is valid. 
+		 * It checks if the sentinels match (in value and sign), and that
+		 * no two free blocks are next to each other.
+		 * It also checks that every free block that can hold the links is
+		 * in the bin for its size, that the bins hold nothing else, and
+		 * that the rover is on a block.
+		 * On a mismatch, it returns false.
+         */
+        bool valid () const {
+            DBG(std::endl << "valid() -- starting...");
+            DBG("valid() -- size = " << store.size());
+
+            size_type left, right;
+            int i = 0;
+            int indexed = 0;
+            bool on_rover = false;
+            bool was_free = false;
+
+            while(i < extent()) {
+                if(i == rover)
+                    on_rover = true;
+                left  = tag(i);
+                if((left == std::numeric_limits<size_type>::min()) || (std::abs(left) > extent() - i - 2*header()))
+                    return false;
+                right = tag(i + std::abs(left) + header());
+                DBG("valid() --  left: " << left << "; right: " << right << "; i: " << i);
+
+                if(left != right)
+                    return false;
+                if(was_free && (left >= 0))
+                    return false;
+                was_free = (left >= 0);
+                if(left >= min_payload())
+                    ++indexed;
+
+                i += std::abs(left) + 2*sizeof(size_type);
+            }
+
+            if((i != extent()) || !on_rover)
+                return false;
+
+            if ((bin_map >> (classes() - 1)) > 1u)
+                return false;
+            for (int k = 0; k < classes(); ++k) {
+                if (((bin_map >> k) & 1u) != (bins[k] != -1))
+                    return false;
+                for (size_type j = bins[k]; j != -1; j = next_of(j)) {
+                    if (!linked(j) || (bin_of(tag(j)) != k) || (--indexed < 0))
+                        return false;}}
+            return indexed == 0;}
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * whether offset i could be the left sentinel of an indexed free block
+         */
+        bool indexed_at (size_type i) const {
+            return (i >= 0) && (i % header() == 0) && (i <= extent() - 2*header() - min_payload()) &&
+                   (tag(i) >= min_payload());}
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * whether the indexed free block at i is linked to blocks that link
+         * back to it, or, if it's the first in its list, is the head of its bin
+         */
+        bool linked (size_type i) const {
+            if (!indexed_at(i))
+                return false;
+            const size_type n = next_of(i);
+            const size_type p = prev_of(i);
+            if ((n != -1) && (!indexed_at(n) || (prev_of(n) != i)))
+                return false;
+            if (p == -1)
+                return bins[bin_of(tag(i))] == i;
+            return indexed_at(p) && (next_of(p) == i);}
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * whether the block at i has matching sentinels inside the heap,
+         * and, if it's indexed, is linked (see linked)
+         */
+        bool sound (size_type i) const {
+            if ((i < 0) || (i % header() != 0) || (i > extent() - 2*header()))
+                return false;
+            const size_type s = tag(i);
+            if ((s == std::numeric_limits<size_type>::min()) || (std::abs(s) > extent() - i - 2*header()) ||
+                (tag(i + std::abs(s) + header()) != s))
+                return false;
+            return (s < min_payload()) || linked(i);}
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * the local check after an allocate or deallocate: the block at i and
+         * the blocks on either side are sound, and no two of them are free
+         * (deallocate would have merged them)
+         */
+        bool sound_around (size_type i) const {
+            if (!sound(i))
+                return false;
+            const bool      is_free = tag(i) >= 0;
+            const size_type j       = i + std::abs(tag(i)) + 2*header();
+            if ((j != extent()) && (!sound(j) || (is_free && (tag(j) >= 0))))
+                return false;
+            if (i == 0)
+                return true;
+            const size_type left = tag(i - header());
+            if ((left == std::numeric_limits<size_type>::min()) || (std::abs(left) > i - 2*header()))
+                return false;
+            const size_type h = i - std::abs(left) - 2*header();
+            return sound(h) && !(is_free && (tag(h) >= 0));}
+
+        /**
+         * O(1) in space
+         * O(1) in time, amortized
+         * valid(), but only on every ALLOCATOR_CHECK_PERIOD-th call in this thread
+         */
+        bool sampled () const {
+            static thread_local unsigned calls  = 0;
+            const unsigned               period = ALLOCATOR_CHECK_PERIOD;
+            return (period == 0) || (++calls % period != 0) || valid();}
+
+        /**
+         * O(1) in space
+         * O(1) in time, amortized
+         * what allocate and deallocate assert about the block at i
+         */
+        bool checked (size_type i) const {
+            return sound_around(i) && sampled();}
+
+        // ----------
+        // initialize
+        // ----------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * makes the whole heap one free block.
+         * Throws bad_alloc if a heap picked at run time can't hold two int
+         * sentinels (for N != 0, the constructor checks at compile time).
+         */
+        void initialize () {
+			if((N == 0) && ((store.size() < 2*sizeof(size_type)) || (store.size() > (std::size_t)std::numeric_limits<size_type>::max()))) {
+				throw std::bad_alloc();
+			}
+            std::fill(bins, bins + classes(), -1);
+            bin_map = 0;
+            set_tags(0, extent() - 2*sizeof(size_type));
+            link(0);
+            rover = 0;
+            counters().initialized();
+            assert(valid());}
+
+    public:
+        // ------------
+        // constructors
+        // ------------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * Initializes the "heap" array with sentinels on both ends of the array.
+		 * The sentinel values (int) indicate the number of blocks that are in between the two sentinels. 
+		 * The sign of these sentinel values dictate the status of these blocks:
+		 * 		positive value indicates the block is free to be given out,
+		 * 		negative value indicates the block is has been given out to some other requestor.
+		 * The whole array then goes into the free-list index as one free block.
+		 * A heap with size that is smaller than the size of two int sentinels
+		 * doesn't compile; Allocator<T, 0> throws bad_alloc, as it has no heap.
+         */
+         
+        Allocator () {
+            static_assert((N == 0) || (N >= 2 * header()), "Allocator<T, N> needs N >= 2 * sizeof(int)");
+            initialize();}
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * for N == 0: a heap in the caller's buffer p[0, s), which must outlive it.
+         * Throws bad_alloc if the buffer can't hold two int sentinels.
+         */
+        Allocator (char* p, size_type s) :
+                store (p, s) {
+            static_assert(N == 0, "only Allocator<T, 0> takes a buffer");
+            initialize();}
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * for N == 0: a heap of s bytes, rounded up to whole pages, mapped from the OS.
+         * Throws bad_alloc if the pages can't be had, or are more than an int can count.
+         */
+        explicit Allocator (size_type s) :
+                store (s) {
+            static_assert(N == 0, "only Allocator<T, 0> takes a size");
+            initialize();}
+
+        // Default copy, destructor, and copy assignment
+        // (Allocator<T, 0> can only be moved)
+        //Allocator  (const Allocator<T>&);
+        //~Allocator ();
+        //Allocator& operator = (const Allocator&);
+
+        // ---------
+        // bytes_for
+        // ---------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * the number of bytes actually handed out for n objects, rounded up to
+         * a whole granule (see granule); a constant, for a constant n.
+         * the product is taken in size_t; n has to be in range (see in_range)
+         * for the result to fit back in a size_type.
+         */
+        static constexpr size_type bytes_for (size_type n) {
+            return (size_type)(((std::size_t)n * sizeof(value_type) + granule() - 1) / granule() * granule());}
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * whether n objects could fit in the heap at all; a negative n can't,
+         * nor can one so big that bytes_for(n) would overflow
+         */
+        bool in_range (size_type n) const {
+            return (n >= 0) && (n <= (capacity() - 2*header()) / (size_type)sizeof(value_type));}
+
+        // --------
+        // allocate
+        // --------
+
+        /**
+         * O(1) in space
+         * O(1) in time (see find_fit)
+         * allocates room for n objects aligned for T.
+         */
+        pointer allocate (size_type n) {
+            return allocate(n, alignof(value_type));}
+
+        /**
+         * O(1) in space
+         * O(1) in time (see find_fit)
+         * allocates the requested amount of space to give out to the user.
+	 * returns the pointer to the first element of the block given out,
+	 * which is a multiple of both alignment and alignof(T).
+	 * the block comes out of the segregated free lists instead of a walk
+	 * over the whole heap. if its payload isn't aligned, the gap in front
+	 * is split off into a free block of its own.
+	 * gives out extra space if the space that is to be left over can't 
+	 * be used once this block is allocated. otherwise, gives out exactly
+	 * how much was asked for (rounded up by bytes_for). 
+	 * throws invalid_argument if alignment is not a power of two.
+	 * throws bad_alloc if there is no space to be given out. 
+         * after allocation there must be enough space left for a valid block
+         * the smallest allowable block is sizeof(T) + (2 * sizeof(int))
+         */
+        pointer allocate (size_type n, size_type alignment) {
+			pointer p = try_allocate(n, alignment);
+			if((p == 0) && (n != 0)) {
+				//if there is no free block available, throw bad_alloc
+				DBG("allocate() -- throwing party in allocate()");
+				throw std::bad_alloc();
+			}
+			return p;}
+
+        // ------------
+        // try_allocate
+        // ------------
+
+        /**
+         * O(1) in space
+         * O(1) in time (see find_fit)
+         * allocate, but returns 0 instead of throwing bad_alloc
+         */
+        pointer try_allocate (size_type n, size_type alignment) {
+			DBG("allocate() -- in allocate()... ");
+			if((alignment <= 0) || ((alignment & (alignment - 1)) != 0))
+				throw std::invalid_argument("Allocator::allocate: alignment must be a power of two");
+			//return 0 if the user requests... well, 0 bytes. undefined behavior.
+			if(n == 0)
+				return 0;
+			//anything that can't fit in the heap, or that bytes_for can't count, fails at once
+			if(!in_range(n)) {
+				counters().failed(long(n) * (long)sizeof(value_type));
+				return 0;
+			}
+			if(alignment < (size_type)alignof(value_type))
+				alignment = alignof(value_type);
+
+			const size_type bytes_needed = bytes_for(n);
+			DBG("allocate() -- bytes_needed: " << bytes_needed);
+
+			size_type i = find_fit(bytes_needed, alignment, P());
+			if(i == -1) {
+				counters().failed(bytes_needed);
+				return 0;
+			}
+			size_type free_delta = -1;
+
+			size_type       left = tag(i);
+			const size_type pad  = padding(i, alignment);
+			unlink(i);
+
+			if(pad != 0) {
+				//the gap in front of the aligned payload becomes a free block
+				set_tags(i, pad - 2*sizeof(size_type));
+				link(i);
+				++free_delta;
+				i    += pad;
+				left -= pad;
+				DBG("allocate() -- padded by " << pad);
+			}
+
+			if(left+2*(int)sizeof(size_type) - (bytes_needed + 2*(int)sizeof(size_type)) <=  2*(int)sizeof(size_type)) {
+				//the leftover could not hold a free block
+				//give the whole damn thing away!
+				set_tags(i, -left);
+				DBG("allocate() -- allocated with extras");
+			}
+			else {
+				//split: the front goes out, the back goes back into the free lists
+				const size_type rest = i + bytes_needed + 2*sizeof(size_type);
+				set_tags(i, -bytes_needed);
+				set_tags(rest, left - bytes_needed - 2*sizeof(size_type));
+				link(rest);
+				++free_delta;
+				DBG("allocate() -- allocated just enough");
+			}
+
+			//the next walk for NextFit starts after this block
+			rover = i + std::abs(tag(i)) + 2*sizeof(size_type);
+			if(rover == extent())
+				rover = 0;
+
+			const pointer p = reinterpret_cast<pointer>(base() + i + sizeof(size_type));
+			counters().allocated(p, bytes_needed, -tag(i), free_delta);
+            assert(checked(i));
+			return p;}
+
+        // ---------
+        // construct
+        // ---------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * constructs an allocator at pointer p.
+         */
+        void construct (pointer p, const_reference v) {
+			DBG("construct() -- constructin a sentry");
+            new (p) T(v);                            // uncomment!
+            assert(sampled());}
+
+        // ----------
+        // deallocate
+        // ----------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * deallocates the block pointed by the argument p. 
+	 * frees up the block to be used by other requests; if there
+	 * are any free blocks adjacent to the block that was just 
+	 * freed, then those blocks are unlinked from their bins and
+	 * merged with the block that is currently being deallocated. 
+         * after deallocation adjacent free blocks must be coalesced
+         * and the coalesced block is linked back into its bin
+         */
+        void deallocate (pointer p, size_type = 0) {
+			DBG("deallocate() -- in deallocate()...");
+			size_type i           = reinterpret_cast<char*>(p) - base() - sizeof(size_type); //offset of the left sentinel
+			const size_type bytes = -tag(i);
+			size_type total_bytes = bytes;
+			size_type free_delta  = 1;
+			assert(total_bytes > 0);
+			DBG("deallocate() -- total_bytes (before merges)= " << total_bytes);
+
+			//ignore the left if the block to be deallocated is the first block in the heap
+			if(i != 0) {
+				const size_type left = tag(i - sizeof(size_type));
+				if(left >= 0) {
+					i -= left + 2*sizeof(size_type);
+					unlink(i);
+					--free_delta;
+					total_bytes += left + 2*sizeof(size_type);
+					DBG("deallocate() -- total_bytes (after left merge)= " << total_bytes);
+				}
+			}
+
+			//ignore the right if the block to be deallocated is the last block in the heap
+			const size_type j = i + total_bytes + 2*sizeof(size_type);
+			if(j != extent()) {
+				const size_type right = tag(j);
+				if(right >= 0) {
+					unlink(j);
+					--free_delta;
+					total_bytes += right + 2*sizeof(size_type);
+					DBG("deallocate() -- total_bytes (after right merge)= " << total_bytes);
+				}
+			}
+
+			set_tags(i, total_bytes);
+			link(i);
+
+			//the rover can't be left inside the coalesced block
+			if((i < rover) && (rover < i + total_bytes + 2*(int)sizeof(size_type)))
+				rover = i;
+
+			counters().deallocated(p, bytes, free_delta);
+
+            assert(checked(i));
+			DBG("deallocate() -- passed checked()");
+			}
+
+        // -------
+        // destroy
+        // -------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * destroys the allocator at pointer p.
          */
         void destroy (pointer p) {
             p->~T();            // uncomment!
-            assert(valid());}
+            assert(sampled());}
 			
-		bool isValid() { return valid(); }
-		};
+        // ----------
+        // try_expand
+        // ----------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * grows the block at p, which holds old_n objects, to hold new_n, by
+         * taking as much of the free block to its right as it needs; what's
+         * left of that block stays free. returns false, and changes nothing,
+         * if the block to the right isn't free or isn't big enough, or if
+         * new_n is out of range (see in_range).
+         */
+        bool try_expand (pointer p, size_type old_n, size_type new_n) {
+            if (!in_range(new_n))
+                return false;
+            const size_type i     = reinterpret_cast<char*>(p) - base() - header();
+            const size_type bytes = -tag(i);
+            const size_type need  = bytes_for(new_n);
+            assert((bytes > 0) && (bytes_for(old_n) <= bytes));
+            (void)old_n;     //only checked
+            if (need <= bytes)
+                return true;
+            const size_type j = i + bytes + 2*header();
+            if ((j == extent()) || (tag(j) < 0) || (bytes + 2*header() + tag(j) < need))
+                return false;
+
+            const size_type merged     = bytes + 2*header() + tag(j);
+            size_type       free_delta = -1;
+            unlink(j);
+            if (merged - need > 2*header()) {
+                //split: what's left of the right block stays free
+                const size_type rest = i + need + 2*header();
+                set_tags(i, -need);
+                set_tags(rest, merged - need - 2*header());
+                link(rest);
+                ++free_delta;}
+            else
+                set_tags(i, -merged);
+
+            //the rover can't be left inside the grown block
+            if (rover == j)
+                rover = (i + std::abs(tag(i)) + 2*header() == extent()) ? 0 : i + std::abs(tag(i)) + 2*header();
+
+            counters().resized(p, bytes, -tag(i), free_delta);
+            assert(checked(i));
+            return true;}
+
+        // ---------------
+        // shrink_in_place
+        // ---------------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * shrinks the block at p, which holds old_n objects, to new_n (> 0),
+         * giving the tail back: into the free block to the right, if there
+         * is one, or else as a new free block, if it's big enough for one.
+         */
+        void shrink_in_place (pointer p, size_type old_n, size_type new_n) {
+            const size_type i     = reinterpret_cast<char*>(p) - base() - header();
+            const size_type bytes = -tag(i);
+            const size_type need  = bytes_for(new_n);
+            assert((bytes > 0) && (bytes_for(old_n) <= bytes) && (new_n > 0));
+            (void)old_n;     //only checked
+            if (need >= bytes)
+                return;
+            const size_type j    = i + bytes + 2*header();
+            const size_type rest = i + need + 2*header();
+            size_type free_delta = 1;
+            if ((j != extent()) && (tag(j) >= 0)) {
+                //the tail joins the free block to the right
+                const size_type right = tag(j);
+                unlink(j);
+                set_tags(i, -need);
+                set_tags(rest, bytes - need + right);
+                link(rest);
+                if (rover == j)
+                    rover = rest;
+                free_delta = 0;}
+            else if (bytes - need > 2*header()) {
+                set_tags(i, -need);
+                set_tags(rest, bytes - need - 2*header());
+                link(rest);}
+            else
+                return;
+
+            counters().resized(p, bytes, need, free_delta);
+            assert(checked(i));}
+
+        // ----------
+        // reallocate
+        // ----------
+
+        /**
+         * O(1) in space
+         * O(n) in time, for the copy, if it has to move
+         * resizes the block at p, which holds old_n objects, to hold new_n:
+         * in place if it shrinks or the free block to its right can take the
+         * growth (see shrink_in_place and try_expand), or else by moving its
+         * bytes to a new block (aligned for T, whatever p was aligned for).
+         * a p of 0 is an allocate and a new_n of 0 a deallocate, as for realloc.
+         * on bad_alloc, p is left as it was.
+         */
+        pointer reallocate (pointer p, size_type old_n, size_type new_n) {
+            static_assert(std::is_trivially_copyable<T>::value, "reallocate moves bytes, so T must be trivially copyable");
+            if (p == 0)
+                return allocate(new_n);
+            if (new_n == 0) {
+                deallocate(p);
+                return 0;}
+            if (new_n <= old_n) {
+                shrink_in_place(p, old_n, new_n);
+                return p;}
+            if (try_expand(p, old_n, new_n))
+                return p;
+            pointer q = allocate(new_n);
+            std::memcpy(static_cast<void*>(q), static_cast<const void*>(p), old_n * sizeof(T));
+            deallocate(p);
+            return q;}
+
+        // --------------
+        // allocate_batch
+        // --------------
+
+        /**
+         * O(1) in space
+         * O(count) in time, plus one search (see find_fit) per free block used
+         * allocates count blocks of n objects each into out[0, count), carving
+         * as many as fit out of each free block found, side by side, and
+         * linking what's left of it once, rather than once per block.
+         * Throws bad_alloc, and allocates nothing, if they don't all fit, or
+         * if n is negative (see in_range).
+         */
+        void allocate_batch (size_type count, size_type n, pointer* out) {
+            assert(n != 0);
+            if (!in_range(n)) {
+                counters().failed(long(n) * (long)sizeof(value_type));
+                throw std::bad_alloc();}
+            const size_type alignment = alignof(value_type);
+            const size_type bytes     = bytes_for(n);
+            const size_type stride    = bytes + 2*header();
+            size_type       done      = 0;
+            while (done != count) {
+                size_type i = find_fit(bytes, alignment, P());
+                if (i == -1) {
+                    counters().failed(bytes);
+                    deallocate_batch(out, done);
+                    throw std::bad_alloc();}
+
+                size_type       left       = tag(i);
+                const size_type pad        = padding(i, alignment);
+                size_type       free_delta = -1;
+                unlink(i);
+                if (pad != 0) {
+                    set_tags(i, pad - 2*header());
+                    link(i);
+                    ++free_delta;
+                    i    += pad;
+                    left -= pad;}
+
+                //a stride that isn't a multiple of the alignment only gets one block a search
+                const size_type m   = (stride % alignment != 0) ? 1 : std::min(count - done, (left + 2*header()) / stride);
+                const size_type rem = left + 2*header() - m * stride;
+                if (rem > 2*header()) {
+                    set_tags(i + m * stride, rem - 2*header());
+                    link(i + m * stride);
+                    ++free_delta;}
+
+                for (size_type k = 0; k != m; ++k) {
+                    const size_type j = i + k * stride;
+                    const size_type b = ((k == m - 1) && (rem <= 2*header())) ? bytes + rem : bytes;
+                    set_tags(j, -b);
+                    out[done++] = reinterpret_cast<pointer>(base() + j + header());
+                    counters().allocated(out[done - 1], bytes, b, (k == m - 1) ? free_delta : 0);}
+
+                rover = offset_of(out[done - 1]) + std::abs(tag(offset_of(out[done - 1]))) + 2*header();
+                if (rover == extent())
+                    rover = 0;
+                assert(checked(i));}}
+
+        // ----------------
+        // deallocate_batch
+        // ----------------
+
+        /**
+         * O(1) in space
+         * O(count log(count)) in time
+         * deallocates the count blocks in ptrs, which it sorts by address, so
+         * that each run of blocks side by side is coalesced, with the free
+         * blocks on either side of it, into one free block in one go.
+         */
+        void deallocate_batch (pointer* ptrs, size_type count) {
+            std::sort(ptrs, ptrs + count, std::less<pointer>());
+            size_type k = 0;
+            while (k != count) {
+                const size_type first = k;
+                size_type       start = offset_of(ptrs[k]);
+                size_type       end   = start;
+                do {
+                    assert(tag(end) < 0);
+                    end += -tag(end) + 2*header();
+                    ++k;}
+                while ((k != count) && (offset_of(ptrs[k]) == end));
+
+                const bool free_left  = (start != 0)     && (tag(start - header()) >= 0);
+                const bool free_right = (end != extent()) && (tag(end) >= 0);
+                for (size_type j = first; j != k; ++j)
+                    counters().deallocated(ptrs[j], -tag(offset_of(ptrs[j])), (j == k - 1) ? 1 - free_left - free_right : 0);
+
+                if (free_left) {
+                    start -= tag(start - header()) + 2*header();
+                    unlink(start);}
+                if (free_right) {
+                    const size_type right = tag(end);
+                    unlink(end);
+                    end += right + 2*header();}
+                set_tags(start, end - start - 2*header());
+                link(start);
+
+                //the rover can't be left inside the coalesced block
+                if ((start < rover) && (rover < end))
+                    rover = start;
+                assert(checked(start));}}
+
+        // -----------
+        // release_all
+        // -----------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * frees every block at once, by making the heap one free block again,
+         * e.g. at the end of a request whose blocks all came from this heap
+         */
+        void release_all () {
+            counters().released();
+            initialize();}
+
+        // --------
+        // capacity
+        // --------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * the number of bytes in the heap, sentinels included: N, or, for
+         * N == 0, however many were picked at run time
+         */
+        size_type capacity () const {
+            return extent();}
+
+        // ----------
+        // block_size
+        // ----------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * returns the number of bytes in the block given out at p,
+         * which may be more than was asked for.
+         */
+        size_type block_size (const_pointer p) const {
+            return -tag(reinterpret_cast<const char*>(p) - base() - sizeof(size_type));}
+
+        // ------------
+        // largest_free
+        // ------------
+
+        /**
+         * O(1) in space
+         * O(n) in time, over the highest non-empty bin only
+         * returns the size of the biggest free block, in bytes.
+         */
+        size_type largest_free () const {
+            if (bin_map == 0)
+                return 0;
+            size_type s = 0;
+            for (size_type i = bins[8 * sizeof(unsigned) - 1 - __builtin_clz(bin_map)]; i != -1; i = next_of(i))
+                s = std::max(s, tag(i));
+            return s;}
+
+        // ----------
+        // total_free
+        // ----------
+
+        /**
+         * O(1) in space
+         * O(n) in time
+         * returns the number of bytes in all of the free blocks.
+         */
+        size_type total_free () const {
+            size_type s = 0;
+            for (size_type i = 0; i < extent(); i += std::abs(tag(i)) + 2 * header())
+                if (tag(i) > 0)
+                    s += tag(i);
+            return s;}
+
+        // -------------
+        // fragmentation
+        // -------------
+
+        /**
+         * O(1) in space
+         * O(n) in time
+         * 1 - largest_free() / total_free(): 0 when all of the free space is in
+         * one block, and closer to 1 the more it's scattered in small ones.
+         * 0 when nothing is free.
+         */
+        double fragmentation () const {
+            const size_type f = total_free();
+            return (f == 0) ? 0 : 1 - double(largest_free()) / f;}
+
+        // -----
+        // stats
+        // -----
+
+        /**
+         * O(1) in space
+         * O(1) in time, but for largest_free (see largest_free)
+         * a snapshot of the counters, and of largest_free, which is read off
+         * the heap, so this is called like allocate is.
+         */
+        AllocatorStats stats () const {
+            AllocatorStats s = counts();
+            s.largest_free = largest_free();
+            return s;}
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * stats() without largest_free (it's 0); this one can be called from
+         * another thread while the heap is in use.
+         */
+        AllocatorStats counts () const {
+            static_assert(S::enabled, "stats() needs an Allocator<T, N, P, Stats>");
+            return counters().snapshot();}
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * has f(context, ...) called after every event (see AllocatorEvent):
+         * ALLOCATED and DEALLOCATED for each block allocate, deallocate and
+         * their _batch forms give out or take back, FAILED for each allocate
+         * or allocate_batch that fails, RESIZED for each block try_expand,
+         * shrink_in_place or reallocate grows or shrinks in place, and
+         * RELEASED for release_all. 0 turns it off. f must not call back
+         * into the allocator.
+         */
+        void hook (AllocatorHook f, void* context) {
+            static_assert(S::enabled, "hook() needs an Allocator<T, N, P, Stats>");
+            counters().set_hook(f, context);}
+
+        // ----
+        // owns
+        // ----
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * whether p points into this heap
+         */
+        bool owns (const_pointer p) const {
+            const char* q = reinterpret_cast<const char*>(p);
+            return (base() <= q) && (q < base() + extent());}
+
+        // -----
+        // empty
+        // -----
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * whether nothing is given out, i.e. the whole heap is one free block
+         */
+        bool empty () const {
+            return tag(0) == extent() - 2 * header();}
+
+        // ----
+        // trim
+        // ----
+
+        /**
+         * O(1) in space
+         * O(n) in time
+         * gives the pages inside free blocks back to the OS, keeping the
+         * sentinels and free-list links. only does anything for a heap that
+         * was mapped for this allocator (N == 0).
+         */
+        void trim () {
+            for (size_type i = 0; i < extent(); i += std::abs(tag(i)) + 2 * header())
+                if (tag(i) > min_payload())
+                    store.release(base() + i + 3 * header(), tag(i) - min_payload());}
+
+        // -------------
+        // validate_full
+        // -------------
+
+        /**
+         * O(1) in space
+         * O(n) in time
+         * the whole-heap check (see valid), whatever ALLOCATOR_CHECK_PERIOD is
+         */
+        bool validate_full () const {
+            return valid();}
+
+		bool isValid() { return validate_full(); }
+		};
+
+// -----------------
+// GrowableAllocator
+// -----------------
+
+/**
+ * an allocator of T that never runs out while the OS has pages to give.
+ * its heap is a chain of Allocator<T, 0> chunks mapped from the OS; when none
+ * of them can serve a request, a new chunk twice the size of the last one (or
+ * big enough for the request) is mapped and linked in front. when a chunk
+ * becomes empty it is unmapped, except for the newest one, whose free pages
+ * are only given back with madvise so that the next burst doesn't remap it.
+ * the resident set therefore stays close to what is live.
+ */
+template <typename T>
+class GrowableAllocator {
+    public:
+        // --------
+        // typedefs
+        // --------
+
+        typedef typename Allocator<T, 0>::value_type      value_type;
+
+        typedef typename Allocator<T, 0>::size_type       size_type;
+        typedef typename Allocator<T, 0>::difference_type difference_type;
+
+        typedef typename Allocator<T, 0>::pointer         pointer;
+        typedef typename Allocator<T, 0>::const_pointer   const_pointer;
+
+        typedef typename Allocator<T, 0>::reference       reference;
+        typedef typename Allocator<T, 0>::const_reference const_reference;
+
+    public:
+        // -----------
+        // operator ==
+        // -----------
+
+        friend bool operator == (const GrowableAllocator& lhs, const GrowableAllocator& rhs) {
+            return &lhs == &rhs;}
+
+        // -----------
+        // operator !=
+        // -----------
+
+        friend bool operator != (const GrowableAllocator& lhs, const GrowableAllocator& rhs) {
+            return !(lhs == rhs);}
+
+    private:
+        // ----
+        // data
+        // ----
+
+        struct Chunk {
+            Allocator<T, 0> heap;
+            Chunk*          next;
+
+            explicit Chunk (size_type s) :
+                    heap (s),
+                    next (0)
+                {}};
+
+        /**
+         * head is the newest, and biggest, chunk;
+         * next_size is the size of the chunk to map after it
+         */
+        Chunk*    head;
+        size_type next_size;
+
+        /**
+         * the biggest chunk that's ever mapped
+         */
+        static size_type max_chunk () {
+            return 1 << 30;}
+
+        // ----
+        // grow
+        // ----
+
+        /**
+         * O(1) in time
+         * maps a chunk that can hold n objects at alignment and links it in front.
+         * throws bad_alloc if the OS is out of pages or the request is too big
+         * for any chunk.
+         */
+        void grow (size_type n, size_type alignment) {
+            const size_type most = (max_chunk() - 4 * (int)sizeof(size_type) - alignment) / (int)sizeof(value_type);
+            if ((n < 0) || (n > most))
+                throw std::bad_alloc();
+            const size_type bytes = Allocator<T, 0>::bytes_for(n) + alignment + 4 * sizeof(size_type);
+            const size_type size  = std::max(next_size, bytes);
+            Chunk* c  = new Chunk(size);
+            c->next   = head;
+            head      = c;
+            next_size = (size < max_chunk() / 2) ? 2 * size : max_chunk();}
+
+    public:
+        // ------------
+        // constructors
+        // ------------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * no chunks yet; the first one will be of (at least) initial bytes
+         */
+        explicit GrowableAllocator (size_type initial = 64 * 1024) :
+                head      (0),
+                next_size (initial)
+            {}
+
+        /**
+         * the chunks belong to this allocator, so it can't be copied
+         */
+        GrowableAllocator             (const GrowableAllocator&) = delete;
+        GrowableAllocator& operator = (const GrowableAllocator&) = delete;
+
+        /**
+         * O(chunks) in time
+         * unmaps every chunk
+         */
+        ~GrowableAllocator () {
+            while (head != 0) {
+                Chunk* c = head;
+                head = head->next;
+                delete c;}}
+
+        // --------
+        // allocate
+        // --------
+
+        /**
+         * O(1) in space
+         * O(chunks) in time
+         * allocates room for n objects aligned for T.
+         */
+        pointer allocate (size_type n) {
+            return allocate(n, alignof(value_type));}
+
+        /**
+         * O(1) in space
+         * O(chunks) in time
+         * tries every chunk, newest first, then maps a new one.
+         * throws bad_alloc if the OS is out of pages.
+         */
+        pointer allocate (size_type n, size_type alignment) {
+            if (n == 0)
+                return 0;
+            for (Chunk* c = head; c != 0; c = c->next)
+                if (pointer p = c->heap.try_allocate(n, alignment))
+                    return p;
+            grow(n, alignment);
+            return head->heap.allocate(n, alignment);}
+
+        // ---------
+        // construct
+        // ---------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         */
+        void construct (pointer p, const_reference v) {
+            new (p) T(v);}
+
+        // ----------
+        // deallocate
+        // ----------
+
+        /**
+         * O(1) in space
+         * O(chunks) in time
+         * deallocates p into its chunk; if that leaves the chunk empty, it's
+         * unmapped, or, if it's the newest, its free pages are given back.
+         */
+        void deallocate (pointer p, size_type = 0) {
+            Chunk** q = &head;
+            while (!(*q)->heap.owns(p)) {
+                q = &(*q)->next;
+                assert(*q != 0);}
+            Chunk* c = *q;
+            c->heap.deallocate(p);
+            if (!c->heap.empty())
+                return;
+            if (c == head)
+                c->heap.trim();
+            else {
+                *q = c->next;
+                delete c;}}
+
+        // -------
+        // destroy
+        // -------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         */
+        void destroy (pointer p) {
+            p->~T();}
+
+        // ------
+        // chunks
+        // ------
+
+        /**
+         * O(chunks) in time
+         * how many chunks are mapped
+         */
+        int chunks () const {
+            int k = 0;
+            for (const Chunk* c = head; c != 0; c = c->next)
+                ++k;
+            return k;}
+
+        /**
+         * O(chunks * n) in time
+         * checks every chunk
+         */
+        bool isValid () {
+            for (Chunk* c = head; c != 0; c = c->next)
+                if (!c->heap.isValid())
+                    return false;
+            return true;}
+        };
+
+// -------------------
+// ConcurrentAllocator
+// -------------------
+
+/**
+ * an Allocator<T, N> that can be shared by many threads.
+ * single objects are handed out of S small magazines of M blocks each; a thread
+ * always uses the same magazine, so its lock is almost never contended. an empty
+ * magazine is refilled, and a full one half emptied, in one batch under the lock
+ * of this arena's heap. whichever thread frees a block puts it into its own
+ * magazine, so a block freed by another thread goes back to the arena it came
+ * from without taking any lock that other arenas share.
+ * requests for more than one object go straight to the heap.
+ */
+template <typename T, int N, int M = 8, int S = 8>
+class ConcurrentAllocator {
+    public:
+        // --------
+        // typedefs
+        // --------
+
+        typedef typename Allocator<T, N>::value_type      value_type;
+
+        typedef typename Allocator<T, N>::size_type       size_type;
+        typedef typename Allocator<T, N>::difference_type difference_type;
+
+        typedef typename Allocator<T, N>::pointer         pointer;
+        typedef typename Allocator<T, N>::const_pointer   const_pointer;
+
+        typedef typename Allocator<T, N>::reference       reference;
+        typedef typename Allocator<T, N>::const_reference const_reference;
+
+    public:
+        // -----------
+        // operator ==
+        // -----------
+
+        friend bool operator == (const ConcurrentAllocator& lhs, const ConcurrentAllocator& rhs) {
+            return &lhs == &rhs;}
+
+        // -----------
+        // operator !=
+        // -----------
+
+        friend bool operator != (const ConcurrentAllocator& lhs, const ConcurrentAllocator& rhs) {
+            return !(lhs == rhs);}
+
+    private:
+        // ----
+        // data
+        // ----
+
+        /**
+         * a magazine sits on its own cache line so that threads using
+         * neighbouring magazines don't share one
+         */
+        struct alignas(64) Magazine {
+            std::mutex lock;
+            pointer    rounds[M];
+            int        count;};
+
+        Allocator<T, N> heap;
+        std::mutex      heap_lock;
+        Magazine        magazines[S];
+
+        // ----------
+        // this_slot
+        // ----------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * the magazine of the calling thread; threads are dealt out round robin
+         */
+        static int this_slot () {
+            static std::atomic<unsigned> next(0);
+            static thread_local unsigned slot = next++;
+            return slot % S;}
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * whether the block at p is one that allocate(1) could have given out
+         * and can therefore be handed out again from a magazine
+         */
+        bool is_round (const_pointer p) const {
+            return heap.block_size(p) <= Allocator<T, N>::bytes_for(1) + 2 * (int)sizeof(size_type);}
+
+        // ------
+        // refill
+        // ------
+
+        /**
+         * O(M) in time
+         * fills half of the empty magazine m from the heap in one batch.
+         * when the heap is out of room, takes a block from another magazine.
+         * m.lock must be held.
+         */
+        void refill (Magazine& m) {
+            {
+            std::lock_guard<std::mutex> g(heap_lock);
+            try {
+                while (m.count < (M + 1) / 2)
+                    m.rounds[m.count++] = heap.allocate(1);}
+            catch (std::bad_alloc&) {}
+            }
+            for (int i = 0; (m.count == 0) && (i < S); ++i) {
+                Magazine& other = magazines[i];
+                if ((&other == &m) || !other.lock.try_lock())
+                    continue;
+                if (other.count != 0)
+                    m.rounds[m.count++] = other.rounds[--other.count];
+                other.lock.unlock();}
+            if (m.count == 0)
+                throw std::bad_alloc();}
+
+        // -----
+        // flush
+        // -----
+
+        /**
+         * O(M) in time
+         * gives the oldest half of the full magazine m back to the heap in one batch.
+         * m.lock must be held.
+         */
+        void flush (Magazine& m) {
+            const int k = M / 2 + 1;
+            {
+            std::lock_guard<std::mutex> g(heap_lock);
+            for (int i = 0; i != k; ++i)
+                heap.deallocate(m.rounds[i]);
+            }
+            std::copy(m.rounds + k, m.rounds + m.count, m.rounds);
+            m.count -= k;}
+
+    public:
+        // ------------
+        // constructors
+        // ------------
+
+        /**
+         * O(S) in time
+         * an empty heap and empty magazines
+         */
+        ConcurrentAllocator () {
+            for (int i = 0; i != S; ++i)
+                magazines[i].count = 0;}
+
+        /**
+         * the magazines hold pointers into this arena, so it can't be copied
+         */
+        ConcurrentAllocator             (const ConcurrentAllocator&) = delete;
+        ConcurrentAllocator& operator = (const ConcurrentAllocator&) = delete;
+
+        // --------
+        // allocate
+        // --------
+
+        /**
+         * O(1) in space
+         * O(1) in time, amortized over a batch
+         * allocate(1) pops the calling thread's magazine, refilling it if it's empty.
+         * anything bigger is allocated from the heap under its lock.
+         * throws bad_alloc if there is no space to be given out.
+         */
+        pointer allocate (size_type n) {
+            if (n != 1) {
+                std::lock_guard<std::mutex> g(heap_lock);
+                return heap.allocate(n);}
+            Magazine& m = magazines[this_slot()];
+            std::lock_guard<std::mutex> g(m.lock);
+            if (m.count == 0)
+                refill(m);
+            return m.rounds[--m.count];}
+
+        // ---------
+        // construct
+        // ---------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         */
+        void construct (pointer p, const_reference v) {
+            new (p) T(v);}
+
+        // ----------
+        // deallocate
+        // ----------
+
+        /**
+         * O(1) in space
+         * O(1) in time, amortized over a batch
+         * a single-object block is pushed onto the calling thread's magazine,
+         * which gives half of itself back to the heap when it's full.
+         * anything bigger is deallocated into the heap under its lock.
+         */
+        void deallocate (pointer p, size_type = 0) {
+            if (!is_round(p)) {
+                std::lock_guard<std::mutex> g(heap_lock);
+                heap.deallocate(p);
+                return;}
+            Magazine& m = magazines[this_slot()];
+            std::lock_guard<std::mutex> g(m.lock);
+            if (m.count == M)
+                flush(m);
+            m.rounds[m.count++] = p;}
+
+        // -------
+        // destroy
+        // -------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         */
+        void destroy (pointer p) {
+            p->~T();}
+
+        // -------
+        // isValid
+        // -------
+
+        /**
+         * O(n) in time
+         * checks the heap; blocks sitting in magazines are busy as far as
+         * the heap is concerned, so this holds at any quiet point
+         */
+        bool isValid () {
+            std::lock_guard<std::mutex> g(heap_lock);
+            return heap.isValid();}
+        };
+
+// -------------
+// SlabAllocator
+// -------------
+
+/**
+ * an Allocator<T, N> with a pool for single objects.
+ * allocate(1) pops a slot off an intrusive free stack; when the stack is empty
+ * a slab of up to K slots is carved out of the heap in one allocate, halving K
+ * until a slab fits. a slot has no sentinels of its own, so each object costs
+ * one slot (see slot) plus 2 * sizeof(int) / K for its share of the slab's
+ * sentinels, instead of sizeof(T) rounded up to an int plus 2 * sizeof(int)
+ * on the boundary-tag path: 8 - 8 / K bytes saved per object with 4-byte
+ * ints, when sizeof(T) is a multiple of 4.
+ * anything bigger goes to the boundary-tag heap, so deallocate must be given
+ * the n that was given to allocate (as with std::allocator) to tell them apart.
+ * slabs stay carved out until the allocator goes away.
+ */
+template <typename T, int N, int K = 16>
+class SlabAllocator {
+    public:
+        // --------
+        // typedefs
+        // --------
+
+        typedef typename Allocator<T, N>::value_type      value_type;
+
+        typedef typename Allocator<T, N>::size_type       size_type;
+        typedef typename Allocator<T, N>::difference_type difference_type;
+
+        typedef typename Allocator<T, N>::pointer         pointer;
+        typedef typename Allocator<T, N>::const_pointer   const_pointer;
+
+        typedef typename Allocator<T, N>::reference       reference;
+        typedef typename Allocator<T, N>::const_reference const_reference;
+
+    public:
+        // -----------
+        // operator ==
+        // -----------
+
+        friend bool operator == (const SlabAllocator& lhs, const SlabAllocator& rhs) {
+            return &lhs == &rhs;}
+
+        // -----------
+        // operator !=
+        // -----------
+
+        friend bool operator != (const SlabAllocator& lhs, const SlabAllocator& rhs) {
+            return !(lhs == rhs);}
+
+    private:
+        // ----
+        // data
+        // ----
+
+        /**
+         * free_slot is the offset (from the start of heap) of the first free
+         * slot, or -1; each free slot holds the offset of the next one.
+         * offsets keep the default copy consistent.
+         */
+        Allocator<T, N> heap;
+        size_type       free_slot;
+
+        /**
+         * the size of one slot: big enough for a T and for the link, and a
+         * multiple of the alignment of both, so that every slot and every link
+         * is aligned like the first (a slab starts on a payload, which is
+         * aligned for both); e.g. 8 bytes for a T of 5 chars
+         */
+        static constexpr size_type slot () {
+            const size_type a = (alignof(value_type) > alignof(size_type)) ? alignof(value_type) : alignof(size_type);
+            const size_type s = (sizeof(value_type) > sizeof(size_type))   ? sizeof(value_type)  : sizeof(size_type);
+            return (s + a - 1) / a * a;}
+
+        // ------
+        // access
+        // ------
+
+        char* base () {
+            return reinterpret_cast<char*>(&heap);}
+
+        size_type& next_of (size_type i) {
+            assert((reinterpret_cast<std::uintptr_t>(base() + i) % alignof(size_type)) == 0);
+            return *reinterpret_cast<size_type*>(base() + i);}
+
+        // -----
+        // carve
+        // -----
+
+        /**
+         * O(K) in time
+         * carves a new slab out of the heap and pushes all of its slots.
+         * throws bad_alloc if not even a one-slot slab fits.
+         */
+        void carve () {
+            for (int k = K; k != 0; k /= 2) {
+                pointer p;
+                try {
+                    p = heap.allocate((k * slot() + sizeof(value_type) - 1) / sizeof(value_type));}
+                catch (std::bad_alloc&) {
+                    continue;}
+                const size_type first = reinterpret_cast<char*>(p) - base();
+                for (int i = k - 1; i >= 0; --i) {
+                    next_of(first + i * slot()) = free_slot;
+                    free_slot = first + i * slot();}
+                return;}
+            throw std::bad_alloc();}
+
+    public:
+        // ------------
+        // constructors
+        // ------------
+
+        /**
+         * O(1) in time
+         * an empty heap and no slabs
+         */
+        SlabAllocator () :
+                free_slot (-1)
+            {}
+
+        // Default copy, destructor, and copy assignment
+
+        // --------
+        // allocate
+        // --------
+
+        /**
+         * O(1) in space
+         * O(1) in time, amortized over a slab
+         * allocate(1) pops a slot, carving a new slab if there are none.
+         * anything bigger is allocated from the heap.
+         * throws bad_alloc if there is no space to be given out.
+         */
+        pointer allocate (size_type n) {
+            if (n != 1)
+                return heap.allocate(n);
+            if (free_slot == -1)
+                carve();
+            const size_type i = free_slot;
+            free_slot = next_of(i);
+            return reinterpret_cast<pointer>(base() + i);}
+
+        // ---------
+        // construct
+        // ---------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         */
+        void construct (pointer p, const_reference v) {
+            new (p) T(v);}
+
+        // ----------
+        // deallocate
+        // ----------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * n must be what was given to allocate.
+         * a single object's slot is pushed back on the free stack;
+         * anything bigger is deallocated into the heap.
+         */
+        void deallocate (pointer p, size_type n) {
+            if (n != 1) {
+                heap.deallocate(p);
+                return;}
+            const size_type i = reinterpret_cast<char*>(p) - base();
+            next_of(i) = free_slot;
+            free_slot  = i;}
+
+        // -------
+        // destroy
+        // -------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         */
+        void destroy (pointer p) {
+            p->~T();}
+
+        /**
+         * O(n) in time
+         * checks the heap; slabs are busy blocks as far as the heap is concerned
+         */
+        bool isValid () {
+            return heap.isValid();}
+        };
+
+// ----------------
+// CompactAllocator
+// ----------------
+
+/**
+ * a heap of N bytes (or, for N == 0, of a size picked at run time, past 2 GiB
+ * if need be) with one header word per block instead of two int sentinels.
+ * the word is a 16-bit one if N < 2^16 - 1, a 32-bit one if N < 2^32 - 1, and
+ * a 64-bit one otherwise (and for N == 0); it holds the size of the block,
+ * header included, which is a multiple of 4, so the low two bits are free for
+ * flags: whether the block is in use, and whether the one before it is.
+ * only a free block has a footer (a copy of its size, for the block after it
+ * to coalesce with), and only a free block has links, so an allocated block
+ * costs just the one word plus rounding; a free one needs four words.
+ * free blocks are kept in size classes, one per power of two, searched as
+ * Allocator's FirstFit does; blocks are only ever aligned for T.
+ */
+template <typename T, std::size_t N>
+class CompactAllocator {
+    public:
+        // --------
+        // typedefs
+        // --------
+
+        typedef T                 value_type;
+
+        typedef std::size_t       size_type;
+        typedef std::ptrdiff_t    difference_type;
+
+        typedef value_type*       pointer;
+        typedef const value_type* const_pointer;
+
+        typedef value_type&       reference;
+        typedef const value_type& const_reference;
+
+        typedef typename std::conditional<(N != 0) && (N < 0xFFFF),     std::uint16_t,
+                typename std::conditional<(N != 0) && (N < 0xFFFFFFFF), std::uint32_t,
+                                                                        std::uint64_t>::type>::type word;
+
+    public:
+        // -----------
+        // operator ==
+        // -----------
+
+        friend bool operator == (const CompactAllocator& lhs, const CompactAllocator& rhs) {
+            return &lhs == &rhs;}
+
+        // -----------
+        // operator !=
+        // -----------
+
+        friend bool operator != (const CompactAllocator& lhs, const CompactAllocator& rhs) {
+            return !(lhs == rhs);}
+
+    private:
+        // ----
+        // data
+        // ----
+
+        /**
+         * bins[k] holds the offset of the first free block whose size is in
+         * [2^k, 2^(k+1)), or nil(); bit k of bin_map is set iff it's not nil().
+         * a heap of N bytes has no block in a bin past floor(log2(N)).
+         */
+        Storage<T, N, word> store;
+        word                bins[(N == 0) ? 64 : floor_log2(N) + 1];
+        std::uint64_t       bin_map;
+
+        // -----
+        // sizes
+        // -----
+
+        static const word in_use      = 1;
+        static const word prev_in_use = 2;
+        static const word flags       = 3;
+
+        static constexpr size_type header () {
+            return sizeof(word);}
+
+        /**
+         * what payloads are aligned for: T, and the words in a free block
+         */
+        static constexpr size_type payload_alignment () {
+            return std::max(alignof(value_type), sizeof(word));}
+
+        /**
+         * what block sizes are a multiple of: payload_alignment(), and 4 for the flags
+         */
+        static constexpr size_type granule () {
+            return std::max(payload_alignment(), (size_type)4);}
+
+        /**
+         * a free block holds its header, two links and a footer
+         */
+        static constexpr size_type min_block () {
+            return (4 * header() + granule() - 1) / granule() * granule();}
+
+        /**
+         * where the first block starts, so that its payload is aligned
+         */
+        static constexpr size_type lead () {
+            return (payload_alignment() - header() % payload_alignment()) % payload_alignment();}
+
+        /**
+         * the end of the last block
+         */
+        size_type limit () const {
+            return (store.size() < lead()) ? 0 : lead() + (store.size() - lead()) / granule() * granule();}
+
+        static constexpr word nil () {
+            return std::numeric_limits<word>::max();}
+
+        /**
+         * the number of size classes (bins): one per power of two up to the heap
+         */
+        static constexpr int classes () {
+            return sizeof(bins) / sizeof(bins[0]);}
+
+        static int bin_of (size_type s) {
+            return 63 - __builtin_clzll(s);}
+
+        // ------
+        // access
+        // ------
+
+        char* base () {
+            return store.data();}
+
+        const char* base () const {
+            return store.data();}
+
+        word& at (size_type o) {
+            return *reinterpret_cast<word*>(base() + o);}
+
+        word at (size_type o) const {
+            return *reinterpret_cast<const word*>(base() + o);}
+
+        size_type size_of (size_type o) const {
+            return at(o) & ~flags;}
+
+        bool used (size_type o) const {
+            return (at(o) & in_use) != 0;}
+
+        /**
+         * the links, in the payload of the free block at o
+         */
+        word& next_of (size_type o) {
+            return at(o + header());}
+
+        word& prev_of (size_type o) {
+            return at(o + 2 * header());}
+
+        word next_of (size_type o) const {
+            return at(o + header());}
+
+        word prev_of (size_type o) const {
+            return at(o + 2 * header());}
+
+        /**
+         * makes the block at o a free one of size s, footer and all; the one
+         * before it is in use, or it would have been coalesced with
+         */
+        void set_free (size_type o, size_type s) {
+            at(o)                = s | prev_in_use;
+            at(o + s - header()) = s;}
+
+        /**
+         * tells the block after the one at o (of size s), if any, whether o is in use
+         */
+        void set_next_prev (size_type o, size_type s, bool u) {
+            if (o + s == limit())
+                return;
+            if (u)
+                at(o + s) |= prev_in_use;
+            else
+                at(o + s) &= ~prev_in_use;}
+
+        // ---------
+        // free list
+        // ---------
+
+        void link (size_type o) {
+            const int k = bin_of(size_of(o));
+            next_of(o) = bins[k];
+            prev_of(o) = nil();
+            if (bins[k] != nil())
+                prev_of(bins[k]) = o;
+            bins[k]  = o;
+            bin_map |= std::uint64_t(1) << k;}
+
+        void unlink (size_type o) {
+            const int  k = bin_of(size_of(o));
+            const word n = next_of(o);
+            const word p = prev_of(o);
+            if (p != nil())
+                next_of(p) = n;
+            else
+                bins[k] = n;
+            if (n != nil())
+                prev_of(n) = p;
+            if (bins[k] == nil())
+                bin_map &= ~(std::uint64_t(1) << k);}
+
+        /**
+         * O(1) in space
+         * O(1) in time, except when only the request's own bin can serve it
+         * the offset of a free block of at least s bytes, or nil(): the head of
+         * the request's own bin if it's big enough, or else the head of the next
+         * non-empty bin up, or else the first big enough in the request's own bin.
+         * a request past the last bin is bigger than the heap.
+         */
+        size_type find_fit (size_type s) const {
+            const int           k     = bin_of(s);
+            if (k >= classes())
+                return nil();
+            const std::uint64_t above = (k < 63) ? (bin_map & (~std::uint64_t(0) << (k + 1))) : 0;
+            if ((bins[k] != nil()) && (size_of(bins[k]) >= s))
+                return bins[k];
+            if (above != 0)
+                return bins[__builtin_ctzll(above)];
+            for (word o = bins[k]; o != nil(); o = next_of(o))
+                if (size_of(o) >= s)
+                    return o;
+            return nil();}
+
+        // -----
+        // valid
+        // -----
+
+        /**
+         * O(1) in space
+         * O(n) in time
+         * whether every block is a whole number of granules inside the heap,
+         * says truly whether the one before it is in use, isn't free next to
+         * another free one, and, if free, has a matching footer and is in the
+         * bin for its size, and whether the bins hold nothing else
+         */
+        bool valid () const {
+            size_type o        = lead();
+            size_type count    = 0;
+            bool      was_used = true;
+            while (o < limit()) {
+                const size_type s = size_of(o);
+                if ((s < min_block()) || (s % granule() != 0) || (s > limit() - o))
+                    return false;
+                if (((at(o) & prev_in_use) != 0) != was_used)
+                    return false;
+                if (!used(o)) {
+                    if (!was_used || (at(o + s - header()) != s))
+                        return false;
+                    ++count;}
+                was_used = used(o);
+                o       += s;}
+            if (o != limit())
+                return false;
+            if ((bin_map >> (classes() - 1)) > 1u)
+                return false;
+            for (int k = 0; k != classes(); ++k) {
+                if (((bin_map >> k) & 1u) != (bins[k] != nil()))
+                    return false;
+                for (word j = bins[k]; j != nil(); j = next_of(j)) {
+                    if ((j >= limit()) || used(j) || (bin_of(size_of(j)) != k) || (count-- == 0))
+                        return false;
+                    if ((next_of(j) != nil()) && (prev_of(next_of(j)) != j))
+                        return false;}}
+            return count == 0;}
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * whether the free block at o is linked to free blocks that link back
+         * to it, or, if it's the first in its list, is the head of its bin
+         */
+        bool linked (size_type o) const {
+            const int  k = bin_of(size_of(o));
+            const word n = next_of(o);
+            const word p = prev_of(o);
+            if ((n != nil()) && ((n >= limit()) || used(n) || (prev_of(n) != o)))
+                return false;
+            if (p == nil())
+                return (bins[k] == o) && (((bin_map >> k) & 1u) != 0);
+            return (p < limit()) && !used(p) && (next_of(p) == o);}
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * whether the block at o is a whole number of granules inside the heap,
+         * and, if free, follows one in use, has a matching footer and is linked
+         * (see linked)
+         */
+        bool sound (size_type o) const {
+            if ((o < lead()) || (o >= limit()) || ((o - lead()) % granule() != 0))
+                return false;
+            const size_type s = size_of(o);
+            if ((s < min_block()) || (s % granule() != 0) || (s > limit() - o))
+                return false;
+            if (used(o))
+                return true;
+            return ((at(o) & prev_in_use) != 0) && (at(o + s - header()) == s) && linked(o);}
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * the local check after an allocate or deallocate: the block at o and
+         * the blocks on either side are sound, the one after it says truly
+         * whether o is in use, and no two of them are free; the one before can
+         * only be found if it's free, from its footer
+         */
+        bool sound_around (size_type o) const {
+            if (!sound(o))
+                return false;
+            const size_type n = o + size_of(o);
+            if ((n != limit()) && (!sound(n) || (((at(n) & prev_in_use) != 0) != used(o)) || (!used(o) && !used(n))))
+                return false;
+            if ((at(o) & prev_in_use) != 0)
+                return true;
+            const size_type left = at(o - header());
+            if ((left > o - lead()) || (left % granule() != 0))
+                return false;
+            return sound(o - left) && !used(o - left) && (size_of(o - left) == left) && used(o);}
+
+        /**
+         * O(1) in space
+         * O(1) in time, amortized
+         * valid(), but only on every ALLOCATOR_CHECK_PERIOD-th call in this thread
+         */
+        bool sampled () const {
+            static thread_local unsigned calls  = 0;
+            const unsigned               period = ALLOCATOR_CHECK_PERIOD;
+            return (period == 0) || (++calls % period != 0) || valid();}
+
+        /**
+         * O(1) in space
+         * O(1) in time, amortized
+         * what allocate and deallocate assert about the block at o
+         */
+        bool checked (size_type o) const {
+            return sound_around(o) && sampled();}
+
+        // ----------
+        // initialize
+        // ----------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * makes the whole heap one free block.
+         * Throws bad_alloc if a heap picked at run time can't hold one, or if a
+         * word can't count its bytes (and still have nil() to spare); for
+         * N != 0, the constructor checks at compile time.
+         */
+        void initialize () {
+            if ((N == 0) && ((limit() < lead() + min_block()) || (limit() > nil())))
+                throw std::bad_alloc();
+            std::fill(bins, bins + classes(), nil());
+            bin_map = 0;
+            set_free(lead(), limit() - lead());
+            link(lead());
+            assert(valid());}
+
+    public:
+        // ------------
+        // constructors
+        // ------------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * N has to hold one free block; CompactAllocator<T, 0> throws bad_alloc,
+         * as it has no heap.
+         */
+        CompactAllocator () {
+            static_assert((N == 0) || (N >= lead() + min_block()), "CompactAllocator<T, N> needs N to hold one free block");
+            initialize();}
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * for N == 0: a heap in the caller's buffer p[0, s), which must outlive it
+         */
+        CompactAllocator (char* p, size_type s) :
+                store (p, s) {
+            static_assert(N == 0, "only CompactAllocator<T, 0> takes a buffer");
+            initialize();}
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * for N == 0: a heap of s bytes, rounded up to whole pages, mapped from
+         * the OS; pages are only backed once they're touched
+         */
+        explicit CompactAllocator (size_type s) :
+                store (s) {
+            static_assert(N == 0, "only CompactAllocator<T, 0> takes a size");
+            initialize();}
+
+        // Default copy, destructor, and copy assignment
+        // (CompactAllocator<T, 0> can only be moved)
+
+        // --------
+        // overhead
+        // --------
+
+        /**
+         * the bytes an allocated block costs beyond its objects, before rounding
+         */
+        static size_type overhead () {
+            return header();}
+
+        // --------
+        // allocate
+        // --------
+
+        /**
+         * O(1) in space
+         * O(1) in time (see find_fit)
+         * allocates n objects in a block of the smallest whole number of
+         * granules that holds them and the header (and could hold a free
+         * block later), splitting off the rest of the block it's taken from
+         * if that's big enough to be a free block of its own.
+         * Throws bad_alloc if nothing fits.
+         */
+        pointer allocate (size_type n) {
+            if (n == 0)
+                return 0;
+            if (n > (limit() - header()) / sizeof(value_type))
+                throw std::bad_alloc();
+            const size_type need = std::max(min_block(), (n * sizeof(value_type) + header() + granule() - 1) / granule() * granule());
+            const size_type o    = find_fit(need);
+            if (o == nil())
+                throw std::bad_alloc();
+            const size_type s = size_of(o);
+            unlink(o);
+            if (s - need >= min_block()) {
+                at(o) = need | in_use | prev_in_use;
+                set_free(o + need, s - need);
+                link(o + need);}
+            else {
+                at(o) = s | in_use | prev_in_use;
+                set_next_prev(o, s, true);}
+            assert(checked(o));
+            return reinterpret_cast<pointer>(base() + o + header());}
+
+        // ---------
+        // construct
+        // ---------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         */
+        void construct (pointer p, const_reference v) {
+            new (p) T(v);}
+
+        // ----------
+        // deallocate
+        // ----------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * frees the block at p, coalescing it with the free blocks on either
+         * side: the one before is found from its footer, if the header of
+         * this one says it's free
+         */
+        void deallocate (pointer p, size_type = 0) {
+            size_type       o = reinterpret_cast<char*>(p) - base() - header();
+            size_type       s = size_of(o);
+            const size_type n = o + s;
+            assert(used(o));
+            if ((at(o) & prev_in_use) == 0) {
+                const size_type left = at(o - header());
+                o -= left;
+                s += left;
+                unlink(o);}
+            if ((n != limit()) && !used(n)) {
+                s += size_of(n);
+                unlink(n);}
+            set_free(o, s);
+            link(o);
+            set_next_prev(o, s, false);
+            assert(checked(o));}
+
+        // -------
+        // destroy
+        // -------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         */
+        void destroy (pointer p) {
+            p->~T();}
+
+        // ----------
+        // block_size
+        // ----------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * the number of bytes in the block given out at p, past its header
+         */
+        size_type block_size (const_pointer p) const {
+            return size_of(reinterpret_cast<const char*>(p) - base() - header()) - header();}
+
+        // ------------
+        // largest_free
+        // ------------
+
+        /**
+         * O(1) in space
+         * O(n) in time, in the blocks of the top non-empty bin
+         * the payload of the biggest free block, or 0
+         */
+        size_type largest_free () const {
+            if (bin_map == 0)
+                return 0;
+            size_type s = 0;
+            for (word o = bins[63 - __builtin_clzll(bin_map)]; o != nil(); o = next_of(o))
+                s = std::max(s, size_of(o));
+            return s - header();}
+
+        // ----------
+        // total_free
+        // ----------
+
+        /**
+         * O(1) in space
+         * O(n) in time
+         * the payloads of all the free blocks
+         */
+        size_type total_free () const {
+            size_type t = 0;
+            for (size_type o = lead(); o < limit(); o += size_of(o))
+                if (!used(o))
+                    t += size_of(o) - header();
+            return t;}
+
+        // -------------
+        // fragmentation
+        // -------------
+
+        /**
+         * O(1) in space
+         * O(n) in time
+         * 1 - largest_free() / total_free(), or 0 when nothing is free
+         */
+        double fragmentation () const {
+            const size_type f = total_free();
+            return (f == 0) ? 0 : 1 - double(largest_free()) / f;}
+
+        // ----
+        // owns
+        // ----
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         */
+        bool owns (const_pointer p) const {
+            const char* c = reinterpret_cast<const char*>(p);
+            return (c >= base() + lead()) && (c < base() + limit());}
+
+        // -----
+        // empty
+        // -----
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * whether nothing is given out
+         */
+        bool empty () const {
+            return !used(lead()) && (size_of(lead()) == limit() - lead());}
+
+		bool isValid() { return valid(); }
+		};
+
+// ---------------
+// BitmapAllocator
+// ---------------
+
+/**
+ * a heap of N bytes cut into at most 64 slots of one T each, with no header
+ * at all: bit i of used says slot i is given out, and bit i of starts that a
+ * block begins there, so a block runs from its start to the next start or
+ * free slot. allocate(n) finds the lowest run of n free slots with a few
+ * shifts and ands on the complement of used (log2(n) of them), and
+ * deallocate clears the block's bits, so both are O(1) and neither walks
+ * or writes the heap. the whole of N is payload; the two words of bits are
+ * all it costs, against two int sentinels per block in Allocator.
+ * see FixedAllocator, which picks this for T and N when it can.
+ */
+template <typename T, int N>
+class BitmapAllocator {
+    public:
+        // --------
+        // typedefs
+        // --------
+
+        typedef T                 value_type;
+
+        typedef int               size_type;
+        typedef std::ptrdiff_t    difference_type;
+
+        typedef value_type*       pointer;
+        typedef const value_type* const_pointer;
+
+        typedef value_type&       reference;
+        typedef const value_type& const_reference;
+
+        typedef std::uint64_t     bits;
+
+        /**
+         * the number of slots
+         */
+        static constexpr size_type slots = N / sizeof(value_type);
+
+        static_assert((slots >= 1) && (slots <= 8 * sizeof(bits)), "BitmapAllocator<T, N> needs N to hold 1 to 64 Ts");
+
+    public:
+        // -----------
+        // operator ==
+        // -----------
+
+        friend bool operator == (const BitmapAllocator& lhs, const BitmapAllocator& rhs) {
+            return &lhs == &rhs;}
+
+        // -----------
+        // operator !=
+        // -----------
+
+        friend bool operator != (const BitmapAllocator& lhs, const BitmapAllocator& rhs) {
+            return !(lhs == rhs);}
+
+    private:
+        // ----
+        // data
+        // ----
+
+        Storage<T, slots * sizeof(T), char> store;
+        bits                                used;
+        bits                                starts;
+
+        /**
+         * a bit for every slot
+         */
+        static constexpr bits all () {
+            return (slots == 8 * sizeof(bits)) ? ~bits(0) : (bits(1) << slots) - 1;}
+
+        /**
+         * n bits from bit i up
+         */
+        static constexpr bits run (size_type i, size_type n) {
+            return ((n == 8 * sizeof(bits)) ? ~bits(0) : (bits(1) << n) - 1) << i;}
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * the number of slots in the block that starts at slot i: up to the
+         * next start or free slot, or the end
+         */
+        size_type length (size_type i) const {
+            const bits ends = ((~used | starts) & all() & ~(bits(1) << i)) >> i >> 1;
+            return (ends == 0) ? slots - i : __builtin_ctzll(ends) + 1;}
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * the slot of p
+         */
+        size_type slot_of (const_pointer p) const {
+            return p - reinterpret_cast<const_pointer>(store.data());}
+
+        // -----
+        // valid
+        // -----
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * every start is used, no bit is past the last slot, and every used
+         * slot either starts a block or follows a used slot
+         */
+        bool valid () const {
+            return ((starts & ~used) == 0) && ((used & ~all()) == 0) &&
+                   ((used & ~starts & ~(used << 1)) == 0);}
+
+    public:
+        // ------------
+        // constructors
+        // ------------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * every slot free
+         */
+        BitmapAllocator () :
+                used   (0),
+                starts (0)
+            {}
+
+        // Default copy, destructor, and copy assignment
+
+        // --------
+        // allocate
+        // --------
+
+        /**
+         * O(1) in space
+         * O(log n) in time, in bit operations
+         * the lowest run of n free slots: free & (free >> 1) has a bit for
+         * every pair of free slots, and so on by doubling, and then by the
+         * rest of n, so that bit i is left set iff slots [i, i + n) are free.
+         * throws bad_alloc if no run of n slots is free.
+         */
+        pointer allocate (size_type n) {
+            if (n == 0)
+                return 0;
+            if ((n < 0) || (n > slots))
+                throw std::bad_alloc();
+            const bits free = ~used & all();
+            bits       r    = free;
+            size_type  k    = 1;
+            for (; 2 * k <= n; k *= 2)
+                r &= r >> k;
+            if (k != n)
+                r &= r >> (n - k);
+            if (r == 0)
+                throw std::bad_alloc();
+            const size_type i = __builtin_ctzll(r);
+            used   |= run(i, n);
+            starts |= bits(1) << i;
+            assert(valid());
+            return reinterpret_cast<pointer>(store.data()) + i;}
+
+        // ---------
+        // construct
+        // ---------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         */
+        void construct (pointer p, const_reference v) {
+            new (p) T(v);}
+
+        // ----------
+        // deallocate
+        // ----------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * frees the block at p; its length is read off the bits
+         */
+        void deallocate (pointer p, size_type = 0) {
+            const size_type i = slot_of(p);
+            assert((i >= 0) && (i < slots) && (((starts >> i) & 1) != 0));
+            used   &= ~run(i, length(i));
+            starts &= ~(bits(1) << i);
+            assert(valid());}
+
+        // -------
+        // destroy
+        // -------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         */
+        void destroy (pointer p) {
+            p->~T();}
+
+        // ----------
+        // block_size
+        // ----------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * the number of bytes in the block given out at p
+         */
+        size_type block_size (const_pointer p) const {
+            return length(slot_of(p)) * sizeof(value_type);}
+
+        // ------------
+        // largest_free
+        // ------------
+
+        /**
+         * O(1) in space
+         * O(k) in time, for a longest free run of k slots
+         * the bytes in the longest run of free slots, or 0
+         */
+        size_type largest_free () const {
+            size_type k = 0;
+            for (bits r = ~used & all(); r != 0; r &= r >> 1)
+                ++k;
+            return k * sizeof(value_type);}
+
+        // ----------
+        // total_free
+        // ----------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         */
+        size_type total_free () const {
+            return __builtin_popcountll(~used & all()) * sizeof(value_type);}
+
+        // -------------
+        // fragmentation
+        // -------------
+
+        /**
+         * O(1) in space
+         * O(1) in time, but for largest_free
+         * 1 - largest_free() / total_free(), or 0 when nothing is free
+         */
+        double fragmentation () const {
+            const size_type f = total_free();
+            return (f == 0) ? 0 : 1 - double(largest_free()) / f;}
+
+        // ----
+        // owns
+        // ----
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         */
+        bool owns (const_pointer p) const {
+            const char* c = reinterpret_cast<const char*>(p);
+            return (c >= store.data()) && (c < store.data() + slots * sizeof(value_type));}
+
+        // -----
+        // empty
+        // -----
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * whether nothing is given out
+         */
+        bool empty () const {
+            return used == 0;}
+
+        bool isValid () const {
+            return valid();}};
+
+/**
+ * the fixed heap of N bytes for T: a BitmapAllocator if N holds 64 Ts or
+ * fewer, and an Allocator otherwise. only what the two have in common
+ * (allocate(n), deallocate, construct, destroy, block_size, largest_free,
+ * total_free, fragmentation, isValid) can be counted on.
+ */
+template <typename T, int N>
+using FixedAllocator = typename std::conditional<(N >= (int)sizeof(T)) && (N / sizeof(T) <= 64),
+                                                 BitmapAllocator<T, N>,
+                                                 Allocator<T, N> >::type;
+
+// -----
+// Arena
+// -----
+
+/**
+ * a heap of N bytes to be shared by ArenaAllocators and ArenaResources
+ */
+template <int N>
+using Arena = Allocator<char, N>;
+
+// --------------
+// ArenaAllocator
+// --------------
+
+/**
+ * a standard allocator of T over an Arena<N> that it doesn't own.
+ * it's a handle: copies, and copies rebound to other types (e.g. the nodes of a
+ * std::list or std::map), allocate from the same arena; handles are equal iff
+ * they share an arena, and the handle travels with the elements on container
+ * copy assignment, move assignment and swap.
+ * the arena must outlive every container that uses it.
+ */
+template <typename T, int N>
+class ArenaAllocator {
+    public:
+        // --------
+        // typedefs
+        // --------
+
+        typedef T                 value_type;
+
+        typedef std::size_t       size_type;
+        typedef std::ptrdiff_t    difference_type;
+
+        typedef value_type*       pointer;
+        typedef const value_type* const_pointer;
+
+        typedef value_type&       reference;
+        typedef const value_type& const_reference;
+
+        typedef std::true_type    propagate_on_container_copy_assignment;
+        typedef std::true_type    propagate_on_container_move_assignment;
+        typedef std::true_type    propagate_on_container_swap;
+        typedef std::false_type   is_always_equal;
+
+        template <typename U>
+        struct rebind {
+            typedef ArenaAllocator<U, N> other;};
+
+    public:
+        // -----------
+        // operator ==
+        // -----------
+
+        template <typename U>
+        friend bool operator == (const ArenaAllocator& lhs, const ArenaAllocator<U, N>& rhs) {
+            return lhs.arena() == rhs.arena();}
+
+        // -----------
+        // operator !=
+        // -----------
+
+        template <typename U>
+        friend bool operator != (const ArenaAllocator& lhs, const ArenaAllocator<U, N>& rhs) {
+            return !(lhs == rhs);}
+
+    private:
+        // ----
+        // data
+        // ----
+
+        Arena<N>* a;
+
+    public:
+        // ------------
+        // constructors
+        // ------------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * a handle on x
+         */
+        explicit ArenaAllocator (Arena<N>& x) :
+                a (&x)
+            {}
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * a handle on the arena of that
+         */
+        template <typename U>
+        ArenaAllocator (const ArenaAllocator<U, N>& that) :
+                a (that.arena())
+            {}
+
+        // Default copy, destructor, and copy assignment
+
+        // -----
+        // arena
+        // -----
+
+        Arena<N>* arena () const {
+            return a;}
+
+        // --------
+        // allocate
+        // --------
+
+        /**
+         * O(1) in space
+         * O(1) in time (see Allocator::allocate)
+         * allocates room for n objects from the arena, aligned for T.
+         * throws bad_alloc if there is no space to be given out.
+         */
+        pointer allocate (size_type n) {
+            if (n > max_size())
+                throw std::bad_alloc();
+            return reinterpret_cast<pointer>(a->allocate(n * sizeof(value_type), alignof(value_type)));}
+
+        // ----------
+        // deallocate
+        // ----------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         */
+        void deallocate (pointer p, size_type) {
+            a->deallocate(reinterpret_cast<char*>(p));}
+
+        // --------
+        // max_size
+        // --------
+
+        /**
+         * the most objects the arena could ever hand out in one block,
+         * which, for Arena<0>, is only known at run time
+         */
+        size_type max_size () const {
+            return a->capacity() / sizeof(value_type);}
+        };
+
+#if __cplusplus >= 201703L
+
+// -------------
+// ArenaResource
+// -------------
+
+/**
+ * a std::pmr::memory_resource over an Arena<N> that it doesn't own,
+ * for the std::pmr containers. resources are equal iff they share an arena.
+ */
+template <int N>
+class ArenaResource : public std::pmr::memory_resource {
+    private:
+        // ----
+        // data
+        // ----
+
+        Arena<N>* a;
+
+        /**
+         * O(1) in space
+         * O(1) in time (see Allocator::allocate)
+         * throws bad_alloc if there is no space to be given out.
+         */
+        void* do_allocate (std::size_t bytes, std::size_t alignment) override {
+            if (bytes > (std::size_t)a->capacity())
+                throw std::bad_alloc();
+            return a->allocate(bytes == 0 ? 1 : bytes, alignment);}
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         */
+        void do_deallocate (void* p, std::size_t, std::size_t) override {
+            a->deallocate(static_cast<char*>(p));}
+
+        bool do_is_equal (const std::pmr::memory_resource& that) const noexcept override {
+            const ArenaResource* r = dynamic_cast<const ArenaResource*>(&that);
+            return (r != 0) && (r->a == a);}
+
+    public:
+        // ------------
+        // constructors
+        // ------------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * a resource on x
+         */
+        explicit ArenaResource (Arena<N>& x) :
+                a (&x)
+            {}
+
+        // -----
+        // arena
+        // -----
+
+        Arena<N>* arena () const {
+            return a;}
+        };
+
+#endif // __cplusplus >= 201703L
 
 #endif // Allocator_h
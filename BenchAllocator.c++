@@ -0,0 +1,936 @@
+// -------------------------------------
+// projects/allocator/BenchAllocator.c++
+// -------------------------------------
+
+/*
+To run the benchmarks:
+    % make BenchAllocator
+    % BenchAllocator                                   # table on stdout
+    % BenchAllocator --json > BenchAllocator.json      # for tracking between releases
+    % BenchAllocator --filter=lifo --min-time=0.5
+
+Every workload is run against Allocator<T, N>, std::allocator<T> and malloc
+for several T and N; N also sets the size of the working set, so that the
+same amount of work is done by all three. Each benchmark is repeated until
+it has run for at least --min-time seconds, and reports ns/op and ops/sec.
+For Allocator, an untimed second run samples the fragmentation of the heap,
+1 - (largest free block / total free bytes), and reports its peak.
+
+The append workload grows two buffers side by side with reallocate, which
+Allocator does in place when it can and malloc with realloc; append_copy is
+the same on Allocator but always allocates, copies and frees, as std::vector
+does. Both report how many times per run a buffer had to move.
+
+The bulk workloads allocate k blocks and free them in random order, with
+allocate_batch and deallocate_batch (bulk_batch) or one call per block
+(bulk_loop), and the *_fifo ones free them in the order they were allocated,
+which deallocate_batch doesn't have to sort much; release_all allocates k
+blocks one at a time and frees them all at once. These run on Allocator
+only, and count 2k ops a run, as lifo does.
+
+The block workloads (lifo, random_free, sawtooth, mixed) also run against
+CompactAllocator<T, N>, with its one header word per block.
+
+The tiny_* workloads are lifo and random_free of single objects on heaps of
+64 Ts, where BitmapAllocator<T, N> (FixedAllocator's pick for them) runs too.
+
+The replay_* workloads play back synthetic allocation traces, in which most
+blocks die young and a few live long, against Allocator under each placement
+policy (FirstFit, NextFit, BestFit, AddressOrderedBestFit), std::allocator and
+malloc, to compare the policies' speed and fragmentation on the same trace.
+*/
+
+// --------
+// includes
+// --------
+
+#include <algorithm> // fill, max, shuffle
+#include <chrono>    // steady_clock
+#include <cstdio>    // fprintf, printf
+#include <cstdlib>   // atof, free, malloc, realloc
+#include <ctime>     // localtime, strftime, time
+#include <functional> // greater, less
+#include <list>      // list
+#include <map>       // map
+#include <new>       // bad_alloc
+#include <queue>     // priority_queue
+#include <random>    // mt19937
+#include <string>    // string, to_string
+#include <thread>    // hardware_concurrency
+#include <type_traits> // is_same
+#include <utility>   // pair
+#include <vector>    // vector
+
+#include "Allocator.h"
+
+// -------
+// Payload
+// -------
+
+/**
+ * a 32-byte object, for something bigger than the scalars
+ */
+struct Payload {
+    double d[4];
+    Payload (int v = 0) {
+        std::fill(d, d + 4, v);}};
+
+template <typename T> const char* type_name ();
+template <> const char* type_name<int>     () {return "int";}
+template <> const char* type_name<double>  () {return "double";}
+template <> const char* type_name<Payload> () {return "Payload";}
+
+// -------------
+// MallocAdaptor
+// -------------
+
+/**
+ * a container allocator for U over malloc and free
+ */
+template <typename U>
+struct MallocAdaptor {
+    typedef U value_type;
+
+    MallocAdaptor () {}
+
+    template <typename V>
+    MallocAdaptor (const MallocAdaptor<V>&) {}
+
+    U* allocate (std::size_t n) {
+        if (void* p = std::malloc(n * sizeof(U)))
+            return static_cast<U*>(p);
+        throw std::bad_alloc();}
+
+    void deallocate (U* p, std::size_t) {
+        std::free(p);}
+
+    template <typename V>
+    bool operator == (const MallocAdaptor<V>&) const {
+        return true;}
+
+    template <typename V>
+    bool operator != (const MallocAdaptor<V>&) const {
+        return false;}};
+
+// ----------
+// contenders
+// ----------
+
+/**
+ * each contender hands out blocks of T, makes container allocators, and
+ * reports the fragmentation of its heap, or -1 if it can't see it
+ */
+template <typename T, int N, typename P = FirstFit, typename S = NoStats>
+struct ArenaHeap {
+    typedef T value_type;
+
+    template <typename U>
+    struct container {
+        typedef ArenaAllocator<U, N> type;};
+
+    Allocator<T, N, P, S>* heap;
+    Arena<N>*              arena;
+
+    ArenaHeap () :
+            heap  (new Allocator<T, N, P, S>),
+            arena (new Arena<N>)
+        {}
+
+    ~ArenaHeap () {
+        delete heap;
+        delete arena;}
+
+    static std::string name () {
+        const std::string p = std::is_same<P, FirstFit>::value ? "" : std::string(",") + P::name();
+        const std::string c = S::enabled ? std::string(",") + S::name() : "";
+        return std::string("Allocator<") + type_name<T>() + "," + std::to_string(N) + p + c + ">";}
+
+    T* allocate (int n) {
+        return heap->allocate(n);}
+
+    void deallocate (T* p, int n) {
+        heap->deallocate(p, n);}
+
+    T* reallocate (T* p, int old_n, int new_n) {
+        return heap->reallocate(p, old_n, new_n);}
+
+    void allocate_batch (int count, int n, T** out) {
+        heap->allocate_batch(count, n, out);}
+
+    void deallocate_batch (T** ptrs, int count) {
+        heap->deallocate_batch(ptrs, count);}
+
+    void release_all () {
+        heap->release_all();}
+
+    template <typename U>
+    typename container<U>::type get () {
+        return typename container<U>::type(*arena);}
+
+    /**
+     * a workload uses either heap or arena, so the worse of the two is its own
+     */
+    double fragmentation () const {
+        return std::max(heap->fragmentation(), arena->fragmentation());}
+
+    /**
+     * after a bad_alloc, blocks may have been lost; start over
+     */
+    void reset () {
+        delete heap;
+        delete arena;
+        heap  = new Allocator<T, N, P, S>;
+        arena = new Arena<N>;}};
+
+template <typename T, int N>
+struct CompactHeap {
+    typedef T value_type;
+
+    CompactAllocator<T, N>* heap;
+
+    CompactHeap () :
+            heap (new CompactAllocator<T, N>)
+        {}
+
+    ~CompactHeap () {
+        delete heap;}
+
+    static std::string name () {
+        return std::string("CompactAllocator<") + type_name<T>() + "," + std::to_string(N) + ">";}
+
+    T* allocate (int n) {
+        return heap->allocate(n);}
+
+    void deallocate (T* p, int n) {
+        heap->deallocate(p, n);}
+
+    double fragmentation () const {
+        return heap->fragmentation();}
+
+    void reset () {
+        delete heap;
+        heap = new CompactAllocator<T, N>;}};
+
+template <typename T, int N>
+struct BitmapHeap {
+    typedef T value_type;
+
+    BitmapAllocator<T, N> heap;
+
+    static std::string name () {
+        return std::string("BitmapAllocator<") + type_name<T>() + "," + std::to_string(N) + ">";}
+
+    T* allocate (int n) {
+        return heap.allocate(n);}
+
+    void deallocate (T* p, int n) {
+        heap.deallocate(p, n);}
+
+    double fragmentation () const {
+        return heap.fragmentation();}
+
+    void reset () {
+        heap = BitmapAllocator<T, N>();}};
+
+template <typename T, int N>
+struct StdHeap {
+    typedef T value_type;
+
+    template <typename U>
+    struct container {
+        typedef std::allocator<U> type;};
+
+    std::allocator<T> heap;
+
+    static std::string name () {
+        return std::string("std::allocator<") + type_name<T>() + ">";}
+
+    T* allocate (int n) {
+        return heap.allocate(n);}
+
+    void deallocate (T* p, int n) {
+        heap.deallocate(p, n);}
+
+    T* reallocate (T* p, int old_n, int new_n) {
+        T* q = heap.allocate(new_n);
+        std::copy(p, p + std::min(old_n, new_n), q);
+        heap.deallocate(p, old_n);
+        return q;}
+
+    template <typename U>
+    typename container<U>::type get () {
+        return typename container<U>::type();}
+
+    double fragmentation () const {
+        return -1;}
+
+    void reset () {}};
+
+template <typename T, int N>
+struct MallocHeap {
+    typedef T value_type;
+
+    template <typename U>
+    struct container {
+        typedef MallocAdaptor<U> type;};
+
+    static std::string name () {
+        return std::string("malloc<") + type_name<T>() + ">";}
+
+    T* allocate (int n) {
+        if (void* p = std::malloc(n * sizeof(T)))
+            return static_cast<T*>(p);
+        throw std::bad_alloc();}
+
+    void deallocate (T* p, int) {
+        std::free(p);}
+
+    T* reallocate (T* p, int, int new_n) {
+        if (void* q = std::realloc(p, new_n * sizeof(T)))
+            return static_cast<T*>(q);
+        throw std::bad_alloc();}
+
+    template <typename U>
+    typename container<U>::type get () {
+        return typename container<U>::type();}
+
+    double fragmentation () const {
+        return -1;}
+
+    void reset () {}};
+
+// -------
+// Sampler
+// -------
+
+/**
+ * keeps the peak fragmentation of a heap, looking at it every period-th op,
+ * and counts the blocks a workload had to move
+ */
+template <typename H>
+struct Sampler {
+    const H* heap;
+    int      period;
+    int      ops;
+    double   peak;
+    long     moves;
+
+    Sampler (const H* h, int p) :
+            heap   (h),
+            period (std::max(p, 1)),
+            ops    (0),
+            peak   (0),
+            moves  (0)
+        {}
+
+    void operator () () {
+        if ((heap != 0) && (++ops % period == 0))
+            peak = std::max(peak, heap->fragmentation());}
+
+    void moved () {
+        ++moves;}};
+
+// ---------
+// workloads
+// ---------
+
+/**
+ * one step of a trace: allocate n objects as block id, or, if n is 0, free it
+ */
+struct Op {
+    int id;
+    int n;
+
+    Op (int i, int m) :
+            id (i),
+            n  (m)
+        {}};
+
+/**
+ * the shape of a run: k blocks of n objects each live at the high-water mark.
+ * each workload below runs once on h and returns the number of operations it did.
+ */
+struct Shape {
+    int              k;
+    int              n;
+    std::vector<int> order;  // a permutation of [0, k)
+    std::vector<int> sizes;  // random block sizes in [1, 2n]
+    std::vector<int> slots;  // random indices into [0, k)
+    std::vector<Op>  trace;  // for replay; block ids in [0, k)
+};
+
+/**
+ * allocates k blocks and frees them in reverse order
+ */
+template <typename H, typename S>
+long lifo (H& h, const Shape& s, S& sample) {
+    std::vector<typename H::value_type*> v(s.k);
+    for (int i = 0; i != s.k; ++i) {
+        v[i] = h.allocate(s.n);
+        sample();}
+    for (int i = s.k; i != 0; --i) {
+        h.deallocate(v[i - 1], s.n);
+        sample();}
+    return 2L * s.k;}
+
+/**
+ * allocates k blocks and frees them in random order
+ */
+template <typename H, typename S>
+long random_free (H& h, const Shape& s, S& sample) {
+    std::vector<typename H::value_type*> v(s.k);
+    for (int i = 0; i != s.k; ++i) {
+        v[i] = h.allocate(s.n);
+        sample();}
+    for (int i = 0; i != s.k; ++i) {
+        h.deallocate(v[s.order[i]], s.n);
+        sample();}
+    return 2L * s.k;}
+
+/**
+ * allocates k blocks, frees every other one, allocates k / 2 blocks twice as
+ * big (which don't fit in the holes), then frees everything
+ */
+template <typename H, typename S>
+long sawtooth (H& h, const Shape& s, S& sample) {
+    std::vector<typename H::value_type*> v(s.k);
+    std::vector<typename H::value_type*> w(s.k / 2);
+    for (int i = 0; i != s.k; ++i) {
+        v[i] = h.allocate(s.n);
+        sample();}
+    for (int i = 1; i < s.k; i += 2) {
+        h.deallocate(v[i], s.n);
+        sample();}
+    for (int i = 0; i != s.k / 2; ++i) {
+        w[i] = h.allocate(2 * s.n);
+        sample();}
+    for (int i = 0; i < s.k; i += 2) {
+        h.deallocate(v[i], s.n);
+        sample();}
+    for (int i = 0; i != s.k / 2; ++i) {
+        h.deallocate(w[i], 2 * s.n);
+        sample();}
+    return s.k + s.k / 2 + (s.k + 1) / 2 + 2L * (s.k / 2);}
+
+/**
+ * keeps k / 2 blocks of random sizes live, replacing a random one at a time
+ */
+template <typename H, typename S>
+long mixed (H& h, const Shape& s, S& sample) {
+    const int m = std::max(s.k / 2, 1);
+    std::vector<typename H::value_type*> v(m);
+    std::vector<int>                     n(m);
+    for (int i = 0; i != m; ++i) {
+        n[i] = s.sizes[i];
+        v[i] = h.allocate(n[i]);
+        sample();}
+    for (std::size_t i = 0; i != s.slots.size(); ++i) {
+        const int j = s.slots[i] % m;
+        h.deallocate(v[j], n[j]);
+        n[j] = s.sizes[(m + i) % s.sizes.size()];
+        v[j] = h.allocate(n[j]);
+        sample();}
+    for (int i = 0; i != m; ++i)
+        h.deallocate(v[i], n[i]);
+    return 2L * m + 2L * s.slots.size();}
+
+/**
+ * grows a vector to k * n elements, one push_back at a time
+ */
+template <typename H, typename S>
+long vector_growth (H& h, const Shape& s, S& sample) {
+    typedef typename H::value_type T;
+    std::vector<T, typename H::template container<T>::type> x(h.template get<T>());
+    for (int i = 0; i != s.k * s.n; ++i) {
+        x.push_back(T(i));
+        sample();}
+    return s.k * s.n;}
+
+/**
+ * pushes k nodes onto the back of a list and pops them off the front
+ */
+template <typename H, typename S>
+long list_fifo (H& h, const Shape& s, S& sample) {
+    typedef typename H::value_type T;
+    std::list<T, typename H::template container<T>::type> x(h.template get<T>());
+    for (int i = 0; i != s.k; ++i) {
+        x.push_back(T(i));
+        sample();}
+    for (int i = 0; i != s.k; ++i) {
+        x.pop_front();
+        sample();}
+    return 2L * s.k;}
+
+/**
+ * inserts k keys into a map in random order and erases them in another
+ */
+template <typename H, typename S>
+long map_churn (H& h, const Shape& s, S& sample) {
+    typedef typename H::value_type                                            T;
+    typedef std::pair<const int, T>                                           V;
+    typedef std::map<int, T, std::less<int>, typename H::template container<V>::type> M;
+    M x(std::less<int>(), h.template get<V>());
+    for (int i = 0; i != s.k; ++i) {
+        x.insert(V(s.order[i], T(i)));
+        sample();}
+    for (int i = 0; i != s.k; ++i) {
+        x.erase(s.order[s.k - 1 - i]);
+        sample();}
+    return 2L * s.k;}
+
+/**
+ * plays back s.trace; every block in it is freed by the end
+ */
+template <typename H, typename S>
+long replay (H& h, const Shape& s, S& sample) {
+    std::vector<typename H::value_type*> v(s.k);
+    std::vector<int>                     n(s.k);
+    for (std::size_t i = 0; i != s.trace.size(); ++i) {
+        const Op& x = s.trace[i];
+        if (x.n != 0) {
+            v[x.id] = h.allocate(x.n);
+            n[x.id] = x.n;}
+        else
+            h.deallocate(v[x.id], n[x.id]);
+        sample();}
+    return s.trace.size();}
+
+/**
+ * appends k * n objects to two buffers in turn, each growing by half (and
+ * by at least n) when it's full: with reallocate if in_place, or else by
+ * allocating, copying and freeing
+ */
+template <bool in_place, typename H, typename S>
+long append (H& h, const Shape& s, S& sample) {
+    typedef typename H::value_type T;
+    T*  p[2]   = {h.allocate(s.n), h.allocate(s.n)};
+    int cap[2] = {s.n, s.n};
+    int len[2] = {0, 0};
+    for (int i = 0; i != s.k * s.n; ++i) {
+        const int b = i & 1;
+        if (len[b] == cap[b]) {
+            const int c = cap[b] + std::max(cap[b] / 2, s.n);
+            T*        q;
+            if (in_place)
+                q = h.reallocate(p[b], cap[b], c);
+            else {
+                q = h.allocate(c);
+                std::copy(p[b], p[b] + len[b], q);
+                h.deallocate(p[b], cap[b]);}
+            if (q != p[b])
+                sample.moved();
+            p[b]   = q;
+            cap[b] = c;}
+        p[b][len[b]++] = T(i);
+        sample();}
+    h.deallocate(p[0], cap[0]);
+    h.deallocate(p[1], cap[1]);
+    return s.k * s.n;}
+
+/**
+ * allocates k blocks and frees them in random order: with one call each way
+ * if batch, or else with one call per block
+ */
+template <bool batch, typename H, typename S>
+long bulk (H& h, const Shape& s, S& sample) {
+    std::vector<typename H::value_type*> v(s.k);
+    std::vector<typename H::value_type*> w(s.k);
+    if (batch)
+        h.allocate_batch(s.k, s.n, &v[0]);
+    else
+        for (int i = 0; i != s.k; ++i)
+            v[i] = h.allocate(s.n);
+    sample();
+    for (int i = 0; i != s.k; ++i)
+        w[i] = v[s.order[i]];
+    if (batch)
+        h.deallocate_batch(&w[0], s.k);
+    else
+        for (int i = 0; i != s.k; ++i)
+            h.deallocate(w[i], s.n);
+    sample();
+    return 2L * s.k;}
+
+/**
+ * allocates k blocks and frees them all with release_all
+ */
+template <typename H, typename S>
+long release (H& h, const Shape& s, S& sample) {
+    for (int i = 0; i != s.k; ++i) {
+        h.allocate(s.n);
+        sample();}
+    h.release_all();
+    sample();
+    return 2L * s.k;}
+
+// ------
+// traces
+// ------
+
+/**
+ * a trace of steps allocations with at most k blocks live, their sizes drawn
+ * from sizes; one block in five lives for about half the trace, the rest for
+ * at most 8 steps, so the long-lived ones are left pinning holes apart.
+ * everything still live at the end is freed in the order it would have died.
+ */
+std::vector<Op> make_trace (int k, int steps, const std::vector<int>& sizes, std::mt19937& g) {
+    typedef std::pair<int, int> Death;                 // (step, id)
+    std::priority_queue<Death, std::vector<Death>, std::greater<Death> > live;
+    std::vector<int> ids;
+    for (int i = k; i != 0; --i)
+        ids.push_back(i - 1);
+    std::vector<Op> t;
+    for (int now = 0; now != steps; ++now) {
+        for (; !live.empty() && (live.top().first <= now); live.pop()) {
+            t.push_back(Op(live.top().second, 0));
+            ids.push_back(live.top().second);}
+        if (ids.empty())
+            continue;
+        const int life = (g() % 5 == 0) ? steps / 4 + g() % (steps / 2 + 1) : 1 + g() % 8;
+        t.push_back(Op(ids.back(), sizes[g() % sizes.size()]));
+        live.push(Death(now + life, ids.back()));
+        ids.pop_back();}
+    for (; !live.empty(); live.pop())
+        t.push_back(Op(live.top().second, 0));
+    return t;}
+
+// -------
+// Options
+// -------
+
+struct Options {
+    bool        json;
+    double      min_time;
+    std::string filter;
+
+    Options () :
+            json     (false),
+            min_time (0.05)
+        {}};
+
+// ------
+// Result
+// ------
+
+struct Result {
+    std::string name;
+    std::string workload;
+    std::string allocator;
+    std::string type;
+    int         arena;
+    long        ops;
+    double      seconds;
+    double      peak_fragmentation;
+    double      moves;          // per run of the workload
+    std::string error;};
+
+// ---
+// run
+// ---
+
+/**
+ * times workload w on a fresh H until min_time has passed, then samples
+ * its fragmentation in one more, untimed, run
+ */
+template <typename H, int N>
+void run (const char* workload, long (*w) (H&, const Shape&, Sampler<H>&), const Shape& s, const Options& o, std::vector<Result>& out) {
+    typedef std::chrono::steady_clock clock;
+    Result r;
+    r.workload  = workload;
+    r.allocator = H::name();
+    r.type      = type_name<typename H::value_type>();
+    r.arena     = N;
+    r.name      = r.workload + "/" + r.allocator + "/" + std::to_string(N) + "/" + std::to_string(s.k) + "x" + std::to_string(s.n);
+    r.ops       = 0;
+    r.seconds   = 0;
+    r.peak_fragmentation = -1;
+    r.moves     = 0;
+    if (r.name.find(o.filter) == std::string::npos)
+        return;
+    H h;
+    try {
+        Sampler<H> none(0, 1);
+        long       runs = 0;
+        const clock::time_point start = clock::now();
+        do {
+            r.ops    += w(h, s, none);
+            r.seconds = std::chrono::duration<double>(clock::now() - start).count();
+            ++runs;}
+        while (r.seconds < o.min_time);
+        r.moves = double(none.moves) / runs;
+        if (h.fragmentation() >= 0) {
+            Sampler<H> sample(&h, s.k / 16);
+            w(h, s, sample);
+            r.peak_fragmentation = sample.peak;}}
+    catch (std::bad_alloc&) {
+        h.reset();
+        r.error = "bad_alloc";}
+    out.push_back(r);}
+
+// -----
+// suite
+// -----
+
+/**
+ * runs every workload against every contender for one T and N
+ */
+template <typename T, int N>
+void suite (const Options& o, std::vector<Result>& out) {
+    std::mt19937 g(N);
+    Shape        s;
+    s.n = 4;
+    s.k = std::max(16, N / (4 * (s.n * (int)sizeof(T) + 2 * (int)sizeof(int))));
+    for (int i = 0; i != s.k; ++i)
+        s.order.push_back(i);
+    std::shuffle(s.order.begin(), s.order.end(), g);
+    for (int i = 0; i != s.k; ++i)
+        s.sizes.push_back(1 + g() % (2 * s.n));
+    for (int i = 0; i != 4 * s.k; ++i)
+        s.slots.push_back(g() % s.k);
+
+    Shape c = s;
+    c.k = std::max(16, N / (8 * ((int)sizeof(T) + 48)));
+    c.n = 1;
+    c.order.clear();
+    for (int i = 0; i != c.k; ++i)
+        c.order.push_back(i);
+    std::shuffle(c.order.begin(), c.order.end(), g);
+
+    typedef ArenaHeap<T, N>  A;
+    typedef StdHeap<T, N>    B;
+    typedef MallocHeap<T, N> C;
+    typedef CompactHeap<T, N> D;
+
+    run<A, N>("lifo", lifo<A, Sampler<A> >, s, o, out);
+    run<B, N>("lifo", lifo<B, Sampler<B> >, s, o, out);
+    run<C, N>("lifo", lifo<C, Sampler<C> >, s, o, out);
+    run<D, N>("lifo", lifo<D, Sampler<D> >, s, o, out);
+
+    run<A, N>("random_free", random_free<A, Sampler<A> >, s, o, out);
+    run<B, N>("random_free", random_free<B, Sampler<B> >, s, o, out);
+    run<C, N>("random_free", random_free<C, Sampler<C> >, s, o, out);
+    run<D, N>("random_free", random_free<D, Sampler<D> >, s, o, out);
+
+    run<A, N>("sawtooth", sawtooth<A, Sampler<A> >, s, o, out);
+    run<B, N>("sawtooth", sawtooth<B, Sampler<B> >, s, o, out);
+    run<C, N>("sawtooth", sawtooth<C, Sampler<C> >, s, o, out);
+    run<D, N>("sawtooth", sawtooth<D, Sampler<D> >, s, o, out);
+
+    run<A, N>("mixed", mixed<A, Sampler<A> >, s, o, out);
+    run<B, N>("mixed", mixed<B, Sampler<B> >, s, o, out);
+    run<C, N>("mixed", mixed<C, Sampler<C> >, s, o, out);
+    run<D, N>("mixed", mixed<D, Sampler<D> >, s, o, out);
+
+    run<A, N>("vector", vector_growth<A, Sampler<A> >, c, o, out);
+    run<B, N>("vector", vector_growth<B, Sampler<B> >, c, o, out);
+    run<C, N>("vector", vector_growth<C, Sampler<C> >, c, o, out);
+
+    run<A, N>("list", list_fifo<A, Sampler<A> >, c, o, out);
+    run<B, N>("list", list_fifo<B, Sampler<B> >, c, o, out);
+    run<C, N>("list", list_fifo<C, Sampler<C> >, c, o, out);
+
+    run<A, N>("map", map_churn<A, Sampler<A> >, c, o, out);
+    run<B, N>("map", map_churn<B, Sampler<B> >, c, o, out);
+    run<C, N>("map", map_churn<C, Sampler<C> >, c, o, out);
+
+    run<A, N>("append",      append<true,  A, Sampler<A> >, s, o, out);
+    run<A, N>("append_copy", append<false, A, Sampler<A> >, s, o, out);
+    run<B, N>("append",      append<true,  B, Sampler<B> >, s, o, out);
+    run<C, N>("append",      append<true,  C, Sampler<C> >, s, o, out);
+
+    Shape f = s;
+    for (int i = 0; i != f.k; ++i)
+        f.order[i] = i;
+
+    run<A, N>("bulk_batch",      bulk<true,  A, Sampler<A> >, s, o, out);
+    run<A, N>("bulk_loop",       bulk<false, A, Sampler<A> >, s, o, out);
+    run<A, N>("bulk_batch_fifo", bulk<true,  A, Sampler<A> >, f, o, out);
+    run<A, N>("bulk_loop_fifo",  bulk<false, A, Sampler<A> >, f, o, out);
+    run<A, N>("release_all", release<A, Sampler<A> >,     s, o, out);}
+
+// ----
+// tiny
+// ----
+
+/**
+ * lifo and random_free of single objects on a heap of at most 64 Ts, which
+ * BitmapAllocator does with a few bit operations a call, against Allocator,
+ * std::allocator and malloc
+ */
+template <typename T, int N>
+void tiny (const Options& o, std::vector<Result>& out) {
+    std::mt19937 g(N + 2);
+    Shape        s;
+    s.n = 1;
+    s.k = std::min(16, N / (int)(sizeof(T) + 2 * sizeof(int)));
+    for (int i = 0; i != s.k; ++i)
+        s.order.push_back(i);
+    std::shuffle(s.order.begin(), s.order.end(), g);
+
+    typedef ArenaHeap<T, N>  A;
+    typedef StdHeap<T, N>    B;
+    typedef MallocHeap<T, N> C;
+    typedef BitmapHeap<T, N> D;
+
+    run<A, N>("tiny_lifo", lifo<A, Sampler<A> >, s, o, out);
+    run<B, N>("tiny_lifo", lifo<B, Sampler<B> >, s, o, out);
+    run<C, N>("tiny_lifo", lifo<C, Sampler<C> >, s, o, out);
+    run<D, N>("tiny_lifo", lifo<D, Sampler<D> >, s, o, out);
+
+    run<A, N>("tiny_random_free", random_free<A, Sampler<A> >, s, o, out);
+    run<B, N>("tiny_random_free", random_free<B, Sampler<B> >, s, o, out);
+    run<C, N>("tiny_random_free", random_free<C, Sampler<C> >, s, o, out);
+    run<D, N>("tiny_random_free", random_free<D, Sampler<D> >, s, o, out);}
+
+// --------
+// policies
+// --------
+
+/**
+ * replays two traces, one with sizes uniform in [1, 2n] and one where one
+ * block in eight is 8n, against each placement policy, std::allocator and malloc,
+ * and against FirstFit keeping Stats, to see what counting costs.
+ * k is picked so that the live blocks fill about a quarter of the heap.
+ */
+template <typename T, int N>
+void policies (const Options& o, std::vector<Result>& out) {
+    std::mt19937 g(N + 1);
+    Shape        u;
+    u.n = 4;
+    for (int i = 0; i != 64; ++i)
+        u.sizes.push_back(1 + g() % (2 * u.n));
+    Shape b = u;
+    for (int i = 0; i < 64; i += 8)
+        b.sizes[i] = 8 * b.n;
+
+    Shape* const traces[] = {&u, &b};
+    for (int i = 0; i != 2; ++i) {
+        Shape& s = *traces[i];
+        long total = 0;
+        for (std::size_t j = 0; j != s.sizes.size(); ++j)
+            total += s.sizes[j] * (int)sizeof(T) + 2 * (int)sizeof(int);
+        s.k     = std::max(16, (int)(N / (4 * total / (long)s.sizes.size())));
+        s.trace = make_trace(s.k, 4 * s.k, s.sizes, g);}
+
+    typedef ArenaHeap<T, N, FirstFit>              A;
+    typedef ArenaHeap<T, N, NextFit>               B;
+    typedef ArenaHeap<T, N, BestFit>               C;
+    typedef ArenaHeap<T, N, AddressOrderedBestFit> D;
+    typedef StdHeap<T, N>                          E;
+    typedef MallocHeap<T, N>                       F;
+    typedef ArenaHeap<T, N, FirstFit, Stats>       G;
+
+    run<A, N>("replay_uniform", replay<A, Sampler<A> >, u, o, out);
+    run<B, N>("replay_uniform", replay<B, Sampler<B> >, u, o, out);
+    run<C, N>("replay_uniform", replay<C, Sampler<C> >, u, o, out);
+    run<D, N>("replay_uniform", replay<D, Sampler<D> >, u, o, out);
+    run<E, N>("replay_uniform", replay<E, Sampler<E> >, u, o, out);
+    run<F, N>("replay_uniform", replay<F, Sampler<F> >, u, o, out);
+    run<G, N>("replay_uniform", replay<G, Sampler<G> >, u, o, out);
+
+    run<A, N>("replay_bimodal", replay<A, Sampler<A> >, b, o, out);
+    run<B, N>("replay_bimodal", replay<B, Sampler<B> >, b, o, out);
+    run<C, N>("replay_bimodal", replay<C, Sampler<C> >, b, o, out);
+    run<D, N>("replay_bimodal", replay<D, Sampler<D> >, b, o, out);
+    run<E, N>("replay_bimodal", replay<E, Sampler<E> >, b, o, out);
+    run<F, N>("replay_bimodal", replay<F, Sampler<F> >, b, o, out);
+    run<G, N>("replay_bimodal", replay<G, Sampler<G> >, b, o, out);}
+
+// ------
+// report
+// ------
+
+double ns_per_op (const Result& r) {
+    return (r.ops == 0) ? 0 : 1e9 * r.seconds / r.ops;}
+
+double ops_per_sec (const Result& r) {
+    return (r.seconds == 0) ? 0 : r.ops / r.seconds;}
+
+void print_table (const std::vector<Result>& v) {
+    std::printf("%-80s %12s %14s %10s %8s\n", "benchmark", "ns/op", "ops/sec", "peak frag", "moves");
+    for (std::size_t i = 0; i != v.size(); ++i) {
+        const Result& r = v[i];
+        if (!r.error.empty())
+            std::printf("%-80s %s\n", r.name.c_str(), r.error.c_str());
+        else if (r.peak_fragmentation < 0)
+            std::printf("%-80s %12.2f %14.0f %10s %8.1f\n", r.name.c_str(), ns_per_op(r), ops_per_sec(r), "-", r.moves);
+        else
+            std::printf("%-80s %12.2f %14.0f %10.3f %8.1f\n", r.name.c_str(), ns_per_op(r), ops_per_sec(r), r.peak_fragmentation, r.moves);}}
+
+void print_json (const std::vector<Result>& v) {
+    char              date[32];
+    const std::time_t now = std::time(0);
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+    std::printf("{\n");
+    std::printf("  \"context\": {\n");
+    std::printf("    \"date\": \"%s\",\n", date);
+    std::printf("    \"num_cpus\": %u,\n", std::thread::hardware_concurrency());
+#ifdef NDEBUG
+    std::printf("    \"library_build_type\": \"release\"\n");
+#else
+    std::printf("    \"library_build_type\": \"debug\"\n");
+#endif
+    std::printf("  },\n");
+    std::printf("  \"benchmarks\": [\n");
+    for (std::size_t i = 0; i != v.size(); ++i) {
+        const Result& r = v[i];
+        std::printf("    {\n");
+        std::printf("      \"name\": \"%s\",\n", r.name.c_str());
+        std::printf("      \"workload\": \"%s\",\n", r.workload.c_str());
+        std::printf("      \"allocator\": \"%s\",\n", r.allocator.c_str());
+        std::printf("      \"value_type\": \"%s\",\n", r.type.c_str());
+        std::printf("      \"N\": %d,\n", r.arena);
+        std::printf("      \"ops\": %ld,\n", r.ops);
+        std::printf("      \"real_time_s\": %.9f,\n", r.seconds);
+        std::printf("      \"ns_per_op\": %.3f,\n", ns_per_op(r));
+        std::printf("      \"ops_per_sec\": %.1f,\n", ops_per_sec(r));
+        std::printf("      \"moves_per_run\": %.1f,\n", r.moves);
+        if (r.peak_fragmentation < 0)
+            std::printf("      \"peak_fragmentation\": null");
+        else
+            std::printf("      \"peak_fragmentation\": %.6f", r.peak_fragmentation);
+        if (!r.error.empty())
+            std::printf(",\n      \"error_occurred\": true,\n      \"error_message\": \"%s\"", r.error.c_str());
+        std::printf("\n    }%s\n", (i + 1 == v.size()) ? "" : ",");}
+    std::printf("  ]\n");
+    std::printf("}\n");}
+
+// ----
+// main
+// ----
+
+int main (int argc, char* argv[]) {
+    Options o;
+    for (int i = 1; i != argc; ++i) {
+        const std::string a = argv[i];
+        if (a == "--json")
+            o.json = true;
+        else if (a.compare(0, 9, "--filter=") == 0)
+            o.filter = a.substr(9);
+        else if (a.compare(0, 11, "--min-time=") == 0)
+            o.min_time = std::atof(a.c_str() + 11);
+        else {
+            std::fprintf(stderr, "usage: %s [--json] [--filter=substring] [--min-time=seconds]\n", argv[0]);
+            return 1;}}
+
+    std::vector<Result> v;
+    suite<int,     1 << 12>(o, v);
+    suite<int,     1 << 16>(o, v);
+    suite<int,     1 << 20>(o, v);
+    suite<double,  1 << 12>(o, v);
+    suite<double,  1 << 16>(o, v);
+    suite<double,  1 << 20>(o, v);
+    suite<Payload, 1 << 16>(o, v);
+    suite<Payload, 1 << 20>(o, v);
+    tiny<int,    256>(o, v);
+    tiny<double, 512>(o, v);
+    policies<int,     1 << 16>(o, v);
+    policies<int,     1 << 20>(o, v);
+    policies<double,  1 << 16>(o, v);
+    policies<Payload, 1 << 20>(o, v);
+
+    if (o.json)
+        print_json(v);
+    else
+        print_table(v);
+    return 0;}
@@ -0,0 +1,621 @@
+// --------------------------------------
+// projects/allocator/ReplayAllocator.c++
+// --------------------------------------
+
+/*
+To record a trace and play it back:
+    % make ReplayAllocator
+    % ReplayAllocator --synthesize=x.trace              # record a synthetic workload
+    % ReplayAllocator x.trace                           # table on stdout
+    % ReplayAllocator x.trace --json > x.json
+    % ReplayAllocator x.trace --heap=67108864 --samples=20 --repeat=5
+
+A trace is what TraceRecorder::save writes: the (op, size, block id,
+timestamp) of each event an Allocator<T, N, P, Stats> reported to its hook,
+the last ones that fit in the recorder's ring. To record one from a real
+program, hook a TraceRecorder to its Allocator and save it on the way out.
+
+Block ids are mapped to slots, so a block freed before the trace starts (the
+ring dropped its allocation) is skipped, and everything still live at the end
+is freed, so every run starts from an empty heap. Sizes are the bytes of the
+recorded blocks, and every contender is asked for exactly that many chars.
+
+The trace is played back against Allocator<char, 0> under each placement
+policy, CompactAllocator<char, 0>, std::allocator<char> and malloc, each on a
+fresh heap of --heap bytes (by default, a few times what was ever live). The
+best of --repeat timed runs gives ns/op; one more, untimed, run samples the
+heap at --samples points evenly spaced through the recorded part of the trace:
+its footprint and its fragmentation, 1 - (largest free block / total free
+bytes). An arena's footprint is the span from its lowest block to the end of
+its highest; malloc's is what it has taken from the OS (glibc only), and its
+fragmentation isn't known.
+*/
+
+// --------
+// includes
+// --------
+
+#include <algorithm> // fill, max, min
+#include <chrono>    // steady_clock
+#include <cstdint>   // uint64_t
+#include <cstdio>    // fprintf, printf
+#include <cstdlib>   // atoi, atol, free, malloc, realloc
+#include <cstring>   // memcpy
+#include <functional> // greater
+#include <limits>    // numeric_limits
+#include <memory>    // allocator
+#include <new>       // bad_alloc
+#include <queue>     // priority_queue
+#include <random>    // mt19937
+#include <string>    // string
+#include <unordered_map> // unordered_map
+#include <utility>   // make_pair, pair
+#include <vector>    // vector
+
+#if defined(__GLIBC__) && ((__GLIBC__ > 2) || (__GLIBC_MINOR__ >= 33))
+#include <malloc.h>  // mallinfo2, malloc_trim
+#define HAVE_MALLINFO2
+#endif
+
+#include "Allocator.h"
+
+// -----
+// Trace
+// -----
+
+/**
+ * a trace, ready to play: each step is on a slot, which holds one block at a time
+ */
+struct Step {
+    int  slot;
+    int  op;        // ALLOCATED, DEALLOCATED, RESIZED or RELEASED
+    long bytes;
+
+    Step (int s, int o, long b) :
+            slot  (s),
+            op    (o),
+            bytes (b)
+        {}};
+
+struct Trace {
+    std::vector<Step> steps;
+    std::size_t       recorded;     // steps before the ones that free what's left
+    int               slots;
+    long              records;
+    long              dropped;      // by the recorder's ring
+    long              skipped;      // frees and resizes of blocks allocated before the trace
+    long              failed;
+    long              peak_blocks;
+    long              peak_bytes;
+    double            seconds;      // from the first record to the last
+
+    Trace () :
+            recorded    (0),
+            slots       (0),
+            records     (0),
+            dropped     (0),
+            skipped     (0),
+            failed      (0),
+            peak_blocks (0),
+            peak_bytes  (0),
+            seconds     (0)
+        {}};
+
+/**
+ * maps the records' block ids to slots, reusing a slot once its block is freed
+ */
+Trace make_trace (const std::vector<TraceRecord>& v, const TraceHeader& h) {
+    Trace t;
+    t.records = v.size();
+    t.dropped = h.dropped;
+    if (!v.empty())
+        t.seconds = (v.back().nanos - v.front().nanos) / 1e9;
+    std::unordered_map<std::uint64_t, int> live;
+    std::vector<int>                       free_slots;
+    std::vector<long>                      bytes;
+    long                                   in_use = 0;
+    for (std::size_t i = 0; i != v.size(); ++i) {
+        const TraceRecord& r = v[i];
+        const std::unordered_map<std::uint64_t, int>::iterator b = live.find(r.id);
+        switch (r.op) {
+            case ALLOCATED: {
+                if (b != live.end()) {
+                    t.steps.push_back(Step(b->second, DEALLOCATED, bytes[b->second]));
+                    in_use -= bytes[b->second];
+                    free_slots.push_back(b->second);
+                    live.erase(b);}
+                int s;
+                if (free_slots.empty()) {
+                    s = t.slots++;
+                    bytes.push_back(0);}
+                else {
+                    s = free_slots.back();
+                    free_slots.pop_back();}
+                live[r.id] = s;
+                bytes[s]   = r.bytes;
+                in_use    += r.bytes;
+                t.steps.push_back(Step(s, ALLOCATED, r.bytes));
+                break;}
+            case DEALLOCATED:
+                if (b == live.end()) {
+                    ++t.skipped;
+                    break;}
+                t.steps.push_back(Step(b->second, DEALLOCATED, bytes[b->second]));
+                in_use -= bytes[b->second];
+                free_slots.push_back(b->second);
+                live.erase(b);
+                break;
+            case RESIZED:
+                if (b == live.end()) {
+                    ++t.skipped;
+                    break;}
+                t.steps.push_back(Step(b->second, RESIZED, r.bytes));
+                in_use += long(r.bytes) - bytes[b->second];
+                bytes[b->second] = r.bytes;
+                break;
+            case FAILED:
+                ++t.failed;
+                break;
+            case RELEASED:
+                t.steps.push_back(Step(-1, RELEASED, 0));
+                for (std::unordered_map<std::uint64_t, int>::iterator j = live.begin(); j != live.end(); ++j)
+                    free_slots.push_back(j->second);
+                live.clear();
+                in_use = 0;
+                break;}
+        t.peak_blocks = std::max(t.peak_blocks, long(live.size()));
+        t.peak_bytes  = std::max(t.peak_bytes,  in_use);}
+    t.recorded = t.steps.size();
+    for (std::unordered_map<std::uint64_t, int>::iterator j = live.begin(); j != live.end(); ++j)
+        t.steps.push_back(Step(j->second, DEALLOCATED, bytes[j->second]));
+    return t;}
+
+// -----------
+// contenders
+// -----------
+
+/**
+ * what the OS has given malloc, or -1 if that can't be known
+ */
+long malloc_footprint () {
+#ifdef HAVE_MALLINFO2
+    const struct mallinfo2 m = mallinfo2();
+    return m.arena + m.hblkhd;
+#else
+    return -1;
+#endif
+    }
+
+/**
+ * what malloc has given out so far, after handing what it can back to the OS,
+ * so that a contender's footprint doesn't count memory that's in use by
+ * something else, but does count free memory that malloc is keeping
+ */
+long malloc_base () {
+#ifdef HAVE_MALLINFO2
+    malloc_trim(0);
+    const struct mallinfo2 m = mallinfo2();
+    return m.arena + m.hblkhd - m.fordblks;
+#else
+    return -1;
+#endif
+    }
+
+/**
+ * an arena's footprint: the span of the blocks it has given out
+ */
+struct Span {
+    const char* lo;
+    const char* hi;
+
+    Span () :
+            lo (0),
+            hi (0)
+        {}
+
+    void add (const char* p, long bytes) {
+        lo = (lo == 0) ? p : std::min(lo, p);
+        hi = std::max(hi, p + bytes);}
+
+    long size () const {
+        return hi - lo;}};
+
+template <typename P>
+struct ArenaHeap {
+    Allocator<char, 0, P> heap;
+    Span                  span;
+
+    explicit ArenaHeap (long bytes) :
+            heap (bytes)
+        {}
+
+    static std::string name () {
+        return std::string("Allocator<char,0,") + P::name() + ">";}
+
+    char* allocate (long bytes) {
+        return heap.allocate(bytes);}
+
+    void deallocate (char* p, long bytes) {
+        heap.deallocate(p, bytes);}
+
+    char* reallocate (char* p, long old_bytes, long bytes) {
+        return heap.reallocate(p, old_bytes, bytes);}
+
+    void release_all (char**, const long*, int) {
+        heap.release_all();}
+
+    void touched (const char* p) {
+        span.add(p, heap.block_size(p));}
+
+    long footprint () const {
+        return span.size();}
+
+    double fragmentation () const {
+        return heap.fragmentation();}};
+
+struct CompactHeap {
+    CompactAllocator<char, 0> heap;
+    Span                      span;
+
+    explicit CompactHeap (long bytes) :
+            heap (bytes)
+        {}
+
+    static std::string name () {
+        return "CompactAllocator<char,0>";}
+
+    char* allocate (long bytes) {
+        return heap.allocate(bytes);}
+
+    void deallocate (char* p, long bytes) {
+        heap.deallocate(p, bytes);}
+
+    char* reallocate (char* p, long old_bytes, long bytes) {
+        char* q = heap.allocate(bytes);
+        std::memcpy(q, p, std::min(old_bytes, bytes));
+        heap.deallocate(p, old_bytes);
+        return q;}
+
+    void release_all (char** p, const long* bytes, int n) {
+        for (int i = 0; i != n; ++i)
+            if (p[i] != 0)
+                heap.deallocate(p[i], bytes[i]);}
+
+    void touched (const char* p) {
+        span.add(p, heap.block_size(p));}
+
+    long footprint () const {
+        return span.size();}
+
+    double fragmentation () const {
+        return heap.fragmentation();}};
+
+struct StdHeap {
+    std::allocator<char> heap;
+    long                 base;
+
+    explicit StdHeap (long) :
+            base (malloc_base())
+        {}
+
+    static std::string name () {
+        return "std::allocator<char>";}
+
+    char* allocate (long bytes) {
+        return heap.allocate(bytes);}
+
+    void deallocate (char* p, long bytes) {
+        heap.deallocate(p, bytes);}
+
+    char* reallocate (char* p, long old_bytes, long bytes) {
+        char* q = heap.allocate(bytes);
+        std::memcpy(q, p, std::min(old_bytes, bytes));
+        heap.deallocate(p, old_bytes);
+        return q;}
+
+    void release_all (char** p, const long* bytes, int n) {
+        for (int i = 0; i != n; ++i)
+            if (p[i] != 0)
+                heap.deallocate(p[i], bytes[i]);}
+
+    void touched (const char*) {}
+
+    long footprint () const {
+        return (base < 0) ? -1 : std::max(0L, malloc_footprint() - base);}
+
+    double fragmentation () const {
+        return -1;}};
+
+struct MallocHeap {
+    long base;
+
+    explicit MallocHeap (long) :
+            base (malloc_base())
+        {}
+
+    static std::string name () {
+        return "malloc";}
+
+    char* allocate (long bytes) {
+        if (void* p = std::malloc(bytes))
+            return static_cast<char*>(p);
+        throw std::bad_alloc();}
+
+    void deallocate (char* p, long) {
+        std::free(p);}
+
+    char* reallocate (char* p, long, long bytes) {
+        if (void* q = std::realloc(p, bytes))
+            return static_cast<char*>(q);
+        throw std::bad_alloc();}
+
+    void release_all (char** p, const long*, int n) {
+        for (int i = 0; i != n; ++i)
+            std::free(p[i]);}
+
+    void touched (const char*) {}
+
+    long footprint () const {
+        return (base < 0) ? -1 : std::max(0L, malloc_footprint() - base);}
+
+    double fragmentation () const {
+        return -1;}};
+
+// -------
+// Options
+// -------
+
+struct Options {
+    bool        json;
+    long        heap;       // bytes, or 0 to size it from the trace
+    int         samples;
+    int         repeat;
+    std::string synthesize; // a path to record a synthetic trace to
+    long        steps;      // of the synthetic trace
+    std::string trace;
+
+    Options () :
+            json    (false),
+            heap    (0),
+            samples (10),
+            repeat  (3),
+            steps   (200000)
+        {}};
+
+// ------
+// Result
+// ------
+
+struct Result {
+    std::string         allocator;
+    double              seconds;        // the best run
+    long                peak_footprint; // -1 if unknown
+    std::vector<double> fragmentation;  // at each sample, or empty if unknown
+    std::string         error;};
+
+// ------
+// replay
+// ------
+
+/**
+ * plays t once on h; if sampling, h is told of every block it gives out,
+ * r gets its peak footprint, looked at a thousand times over the trace,
+ * and its fragmentation at o.samples points
+ */
+template <typename H>
+void play (H& h, const Trace& t, const Options& o, bool sampling, Result& r) {
+    std::vector<char*> p(t.slots, static_cast<char*>(0));
+    std::vector<long>  bytes(t.slots, 0);
+    std::size_t        next   = 0;              // the next sample
+    const std::size_t  period = std::max<std::size_t>(t.recorded / 1000, 1);
+    for (std::size_t i = 0; i != t.steps.size(); ++i) {
+        const Step& s = t.steps[i];
+        switch (s.op) {
+            case ALLOCATED:
+                p[s.slot]     = h.allocate(s.bytes);
+                bytes[s.slot] = s.bytes;
+                break;
+            case DEALLOCATED:
+                h.deallocate(p[s.slot], bytes[s.slot]);
+                p[s.slot] = 0;
+                break;
+            case RESIZED:
+                p[s.slot]     = h.reallocate(p[s.slot], bytes[s.slot], s.bytes);
+                bytes[s.slot] = s.bytes;
+                break;
+            case RELEASED:
+                h.release_all(p.data(), bytes.data(), t.slots);
+                std::fill(p.begin(), p.end(), static_cast<char*>(0));
+                break;}
+        if (!sampling)
+            continue;
+        if ((s.op == ALLOCATED) || (s.op == RESIZED))
+            h.touched(p[s.slot]);
+        if ((i % period == 0) || (i + 1 == t.steps.size()))
+            r.peak_footprint = std::max(r.peak_footprint, h.footprint());
+        for (; (next != std::size_t(o.samples)) && (i + 1 >= (next + 1) * t.recorded / o.samples); ++next)
+            if (h.fragmentation() >= 0)
+                r.fragmentation.push_back(h.fragmentation());}}
+
+/**
+ * times the best of o.repeat runs of t, each on a fresh H of heap bytes,
+ * then samples one more
+ */
+template <typename H>
+void replay (const Trace& t, long heap, const Options& o, std::vector<Result>& out) {
+    typedef std::chrono::steady_clock clock;
+    Result r;
+    r.allocator      = H::name();
+    r.seconds        = 0;
+    r.peak_footprint = -1;
+    try {
+        for (int k = 0; k != o.repeat; ++k) {
+            H h(heap);
+            const clock::time_point start = clock::now();
+            play(h, t, o, false, r);
+            const double s = std::chrono::duration<double>(clock::now() - start).count();
+            r.seconds = (k == 0) ? s : std::min(r.seconds, s);}
+        H h(heap);
+        play(h, t, o, true, r);}
+    catch (std::bad_alloc&) {
+        r.error = "bad_alloc (try a bigger --heap)";}
+    out.push_back(r);}
+
+// ----------
+// synthesize
+// ----------
+
+/**
+ * records a synthetic workload to o.synthesize: most blocks die within a few
+ * steps, one in five lives for a good part of the trace, and one in ten grows
+ * with reallocate before it dies
+ */
+int synthesize (const Options& o) {
+    const long sizes[] = {8, 16, 24, 32, 48, 64, 96, 128, 256, 512, 1024, 4096};
+    Allocator<char, 0, FirstFit, Stats> x(64L << 20);
+    TraceRecorder r(3 * o.steps);
+    x.hook(TraceRecorder::record, &r);
+    std::mt19937 g(o.steps);
+    typedef std::pair<long, std::pair<char*, long> > Death;        // (step, (p, bytes))
+    std::priority_queue<Death, std::vector<Death>, std::greater<Death> > live;
+    for (long now = 0; now != o.steps; ++now) {
+        for (; !live.empty() && (live.top().first <= now); live.pop())
+            x.deallocate(live.top().second.first, live.top().second.second);
+        const long life  = (g() % 5 == 0) ? o.steps / 4 + g() % (o.steps / 2 + 1) : 1 + g() % 8;
+        long       bytes = sizes[g() % (sizeof(sizes) / sizeof(sizes[0]))];
+        char*      p     = x.allocate(bytes);
+        if (g() % 10 == 0) {
+            p      = x.reallocate(p, bytes, 2 * bytes);
+            bytes *= 2;}
+        live.push(Death(now + life, std::make_pair(p, bytes)));}
+    for (; !live.empty(); live.pop())
+        x.deallocate(live.top().second.first, live.top().second.second);
+    if (!r.save(o.synthesize.c_str())) {
+        std::fprintf(stderr, "can't write %s\n", o.synthesize.c_str());
+        return 1;}
+    std::printf("%s: %zu records, %lu dropped\n", o.synthesize.c_str(), r.size(), (unsigned long)r.dropped());
+    return 0;}
+
+// ------
+// report
+// ------
+
+void print_table (const Trace& t, const std::vector<Result>& v, const Options& o) {
+    std::printf("%s: %ld records (%ld dropped), %zu steps, %ld skipped, %ld failed, %.3f s recorded\n",
+                o.trace.c_str(), t.records, t.dropped, t.steps.size(), t.skipped, t.failed, t.seconds);
+    std::printf("peak live: %ld blocks, %ld bytes\n\n", t.peak_blocks, t.peak_bytes);
+    std::printf("%-40s %10s %12s %16s  %s\n", "allocator", "ns/op", "total ms", "peak footprint", "fragmentation over time");
+    for (std::size_t i = 0; i != v.size(); ++i) {
+        const Result& r = v[i];
+        if (!r.error.empty()) {
+            std::printf("%-40s %s\n", r.allocator.c_str(), r.error.c_str());
+            continue;}
+        std::printf("%-40s %10.2f %12.3f ", r.allocator.c_str(), 1e9 * r.seconds / std::max<std::size_t>(t.steps.size(), 1), 1e3 * r.seconds);
+        if (r.peak_footprint < 0)
+            std::printf("%16s  ", "-");
+        else
+            std::printf("%16ld  ", r.peak_footprint);
+        if (r.fragmentation.empty())
+            std::printf("-");
+        for (std::size_t k = 0; k != r.fragmentation.size(); ++k)
+            std::printf("%s%.2f", (k == 0) ? "" : " ", r.fragmentation[k]);
+        std::printf("\n");}}
+
+void print_json (const Trace& t, const std::vector<Result>& v, const Options& o) {
+    std::printf("{\n");
+    std::printf("  \"trace\": {\n");
+    std::printf("    \"path\": \"%s\",\n", o.trace.c_str());
+    std::printf("    \"records\": %ld,\n", t.records);
+    std::printf("    \"dropped\": %ld,\n", t.dropped);
+    std::printf("    \"steps\": %zu,\n", t.steps.size());
+    std::printf("    \"skipped\": %ld,\n", t.skipped);
+    std::printf("    \"failed\": %ld,\n", t.failed);
+    std::printf("    \"recorded_s\": %.9f,\n", t.seconds);
+    std::printf("    \"peak_blocks\": %ld,\n", t.peak_blocks);
+    std::printf("    \"peak_bytes\": %ld\n", t.peak_bytes);
+    std::printf("  },\n");
+    std::printf("  \"heap_bytes\": %ld,\n", o.heap);
+    std::printf("  \"results\": [\n");
+    for (std::size_t i = 0; i != v.size(); ++i) {
+        const Result& r = v[i];
+        std::printf("    {\n");
+        std::printf("      \"allocator\": \"%s\",\n", r.allocator.c_str());
+        std::printf("      \"real_time_s\": %.9f,\n", r.seconds);
+        std::printf("      \"ns_per_op\": %.3f,\n", 1e9 * r.seconds / std::max<std::size_t>(t.steps.size(), 1));
+        if (r.peak_footprint < 0)
+            std::printf("      \"peak_footprint\": null,\n");
+        else
+            std::printf("      \"peak_footprint\": %ld,\n", r.peak_footprint);
+        if (r.fragmentation.empty())
+            std::printf("      \"fragmentation\": null");
+        else {
+            std::printf("      \"fragmentation\": [");
+            for (std::size_t k = 0; k != r.fragmentation.size(); ++k)
+                std::printf("%s%.6f", (k == 0) ? "" : ", ", r.fragmentation[k]);
+            std::printf("]");}
+        if (!r.error.empty())
+            std::printf(",\n      \"error_occurred\": true,\n      \"error_message\": \"%s\"", r.error.c_str());
+        std::printf("\n    }%s\n", (i + 1 == v.size()) ? "" : ",");}
+    std::printf("  ]\n");
+    std::printf("}\n");}
+
+// ----
+// main
+// ----
+
+int main (int argc, char* argv[]) {
+    Options o;
+    for (int i = 1; i != argc; ++i) {
+        const std::string a = argv[i];
+        if (a == "--json")
+            o.json = true;
+        else if (a.compare(0, 7, "--heap=") == 0)
+            o.heap = std::atol(a.c_str() + 7);
+        else if (a.compare(0, 10, "--samples=") == 0)
+            o.samples = std::max(1, std::atoi(a.c_str() + 10));
+        else if (a.compare(0, 9, "--repeat=") == 0)
+            o.repeat = std::max(1, std::atoi(a.c_str() + 9));
+        else if (a.compare(0, 13, "--synthesize=") == 0)
+            o.synthesize = a.substr(13);
+        else if (a.compare(0, 8, "--steps=") == 0)
+            o.steps = std::max(1L, std::atol(a.c_str() + 8));
+        else if ((a.compare(0, 2, "--") != 0) && o.trace.empty())
+            o.trace = a;
+        else {
+            o.trace.clear();
+            break;}}
+    if (o.trace.empty() == o.synthesize.empty()) {
+        std::fprintf(stderr, "usage: %s [--json] [--heap=bytes] [--samples=k] [--repeat=r] trace\n", argv[0]);
+        std::fprintf(stderr, "       %s --synthesize=trace [--steps=n]\n", argv[0]);
+        return 1;}
+    if ((o.heap < 0) || (o.heap > std::numeric_limits<int>::max())) {
+        std::fprintf(stderr, "--heap=%ld is out of range: an Allocator's heap holds at most %d bytes\n", o.heap, std::numeric_limits<int>::max());
+        return 1;}
+    if (!o.synthesize.empty())
+        return synthesize(o);
+
+    std::vector<TraceRecord> records;
+    TraceHeader              h;
+    if (!TraceRecorder::load(o.trace.c_str(), records, h)) {
+        std::fprintf(stderr, "can't read a trace from %s\n", o.trace.c_str());
+        return 1;}
+    const Trace t = make_trace(records, h);
+    records.clear();
+    records.shrink_to_fit();
+    if (o.heap == 0)
+        o.heap = std::min(std::max(1L << 20, 4 * t.peak_bytes + 64 * t.peak_blocks), long(std::numeric_limits<int>::max()) / 2);
+
+    std::vector<Result> v;
+    replay< ArenaHeap<FirstFit>              >(t, o.heap, o, v);
+    replay< ArenaHeap<NextFit>               >(t, o.heap, o, v);
+    replay< ArenaHeap<BestFit>               >(t, o.heap, o, v);
+    replay< ArenaHeap<AddressOrderedBestFit> >(t, o.heap, o, v);
+    replay< CompactHeap                      >(t, o.heap, o, v);
+    replay< StdHeap                          >(t, o.heap, o, v);
+    replay< MallocHeap                       >(t, o.heap, o, v);
+
+    if (o.json)
+        print_json(t, v, o);
+    else
+        print_table(t, v, o);
+    return 0;}
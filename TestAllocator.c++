@@ -12,7 +12,7 @@ To test the program:
     ...
     % locate libcppunit.a
     /usr/lib/libcppunit.a
-    % g++ -pedantic -std=c++0x -Wall Allocator.c++ TestAllocator.c++ -o TestAllocator -lcppunit -ldl
+    % g++ -pedantic -std=c++17 -Wall -pthread Allocator.c++ TestAllocator.c++ -o TestAllocator -lcppunit -ldl
     % valgrind TestAllocator >& TestAllocator.out
 */
 
@@ -24,13 +24,31 @@ To test the program:
 #define DBG(str) do { } while ( false )
 #endif
 
+//the heaps here are small, so check all of one after every allocate and deallocate
+#define ALLOCATOR_CHECK_PERIOD 1
+
 // --------
 // includes
 // --------
 
-#include <algorithm> // count
+#include <algorithm> // count, equal, fill
+#include <cstdint>   // uintptr_t
+#include <cstdio>    // fopen, fwrite, remove
+#include <functional> // equal_to, hash, less, ref
 #include <iostream>  // ios_base
-#include <memory>    // allocator
+#include <limits>    // numeric_limits
+#include <list>      // list
+#include <map>       // map
+#include <memory>    // allocator, allocator_traits, unique_ptr
+#include <memory_resource> // pmr
+#include <numeric>   // accumulate
+#include <stdexcept> // invalid_argument
+#include <string>    // pmr::string
+#include <thread>    // thread
+#include <type_traits> // is_same
+#include <unordered_map> // unordered_map
+#include <utility>   // make_pair, move, pair
+#include <vector>    // vector
 
 #include "cppunit/extensions/HelperMacros.h" // CPPUNIT_TEST, CPPUNIT_TEST_SUITE, CPPUNIT_TEST_SUITE_END
 #include "cppunit/TestFixture.h"             // TestFixture
@@ -208,6 +226,25 @@ struct TestAllocator2 : CppUnit::TestFixture {
 		} catch (std::bad_alloc e) {}
 		DBG("-------------------------finished test_allocate_3");
 	}
+
+	void test_allocate_4 () {
+		B x;
+		//too big for the heap, or negative: bytes_for can't count them
+		const int sizes[] = {std::numeric_limits<int>::max(), 1 << 29, -1};
+		for (int n : sizes) {
+			try {
+				x.allocate(n);
+				CPPUNIT_ASSERT(false);
+			} catch (std::bad_alloc&) {}
+			pointer out[2];
+			try {
+				x.allocate_batch(2, n, out);
+				CPPUNIT_ASSERT(false);
+			} catch (std::bad_alloc&) {}
+		}
+		CPPUNIT_ASSERT(x.try_allocate(std::numeric_limits<int>::max(), 8) == 0);
+		CPPUNIT_ASSERT(x.isValid());
+	}
 	
 	// ---------------
 	// test_deallocate
@@ -255,6 +292,52 @@ struct TestAllocator2 : CppUnit::TestFixture {
 		DBG("-------------------------finished test_deallocate_1-------------------------");
 	}	
 	
+	void test_deallocate_4 () {
+		B x;
+		pointer p1 = x.allocate(4);
+		pointer p2 = x.allocate(4);
+		pointer p3 = x.allocate(4);
+		x.deallocate(p1);
+		x.deallocate(p3);
+		x.deallocate(p2);
+		CPPUNIT_ASSERT(x.isValid());
+		//everything coalesced back into one block, so the whole heap can go out again
+		pointer p = x.allocate((100 - 2*sizeof(int)) / sizeof(value_type));
+		CPPUNIT_ASSERT(p == p1);
+		x.deallocate(p);
+	}
+	
+	// ------------------
+	// test_validate_full
+	// ------------------
+
+	void test_validate_full () {
+		B x;
+		pointer p = x.allocate(2);
+		x.allocate(2);
+		CPPUNIT_ASSERT(x.validate_full());
+		//p's right sentinel
+		int* r = reinterpret_cast<int*>(reinterpret_cast<char*>(p) + x.block_size(p));
+		const int v = *r;
+		*r = 12345;
+		CPPUNIT_ASSERT(!x.validate_full());
+		*r = v;
+		CPPUNIT_ASSERT(x.validate_full());
+	}
+
+	void test_deallocate_5 () {
+		B x;
+		pointer p1 = x.allocate(8);
+		pointer p2 = x.allocate(1);
+		x.deallocate(p1);
+		//the freed block is reused through the free lists
+		pointer p3 = x.allocate(8);
+		CPPUNIT_ASSERT(p3 == p1);
+		x.deallocate(p2);
+		x.deallocate(p3);
+		CPPUNIT_ASSERT(x.isValid());
+	}
+	
     // -----
     // suite
     // -----
@@ -277,12 +360,1417 @@ struct TestAllocator2 : CppUnit::TestFixture {
     CPPUNIT_TEST(test_allocate_1);
     CPPUNIT_TEST(test_allocate_2);
     CPPUNIT_TEST(test_allocate_3);
+    CPPUNIT_TEST(test_allocate_4);
     CPPUNIT_TEST(test_deallocate_1);
     CPPUNIT_TEST(test_deallocate_2);
     CPPUNIT_TEST(test_deallocate_3);
+    CPPUNIT_TEST(test_deallocate_4);
+    CPPUNIT_TEST(test_deallocate_5);
+    CPPUNIT_TEST(test_validate_full);
+    CPPUNIT_TEST_SUITE_END();};
+
+
+// -----------------------
+// TestConcurrentAllocator
+// -----------------------
+
+struct TestConcurrentAllocator : CppUnit::TestFixture {
+    typedef ConcurrentAllocator<int, 1 << 16> A;
+    typedef A::pointer                        pointer;
+
+    static const int threads = 4;
+    static const int rounds  = 1000;
+
+    // ----------
+    // test_churn
+    // ----------
+
+    /**
+     * every thread allocates, checks and frees its own blocks
+     */
+    static void churn (A& x, int t) {
+        std::vector<std::pair<pointer, int> > v;
+        for (int i = 0; i != rounds; ++i) {
+            const int n = (i % 7 == 0) ? 1 + i % 5 : 1;
+            pointer p = x.allocate(n);
+            std::fill(p, p + n, t);
+            v.push_back(std::make_pair(p, n));
+            if (i % 3 == 2) {
+                for (int j = 0; j != 2; ++j) {
+                    CPPUNIT_ASSERT(std::count(v.back().first, v.back().first + v.back().second, t) == v.back().second);
+                    x.deallocate(v.back().first, v.back().second);
+                    v.pop_back();}}}
+        for (std::size_t j = 0; j != v.size(); ++j)
+            x.deallocate(v[j].first, v[j].second);}
+
+    void test_churn () {
+        A x;
+        std::vector<std::thread> v;
+        for (int t = 0; t != threads; ++t)
+            v.push_back(std::thread(churn, std::ref(x), t));
+        for (int t = 0; t != threads; ++t)
+            v[t].join();
+        CPPUNIT_ASSERT(x.isValid());}
+
+    // -----------------
+    // test_remote_frees
+    // -----------------
+
+    /**
+     * every thread frees the blocks that its neighbour allocated
+     */
+    static void fill (A& x, std::vector<pointer>& v, int t) {
+        for (int i = 0; i != rounds; ++i) {
+            v.push_back(x.allocate(1));
+            *v.back() = t;}}
+
+    static void drain (A& x, std::vector<pointer>& v, int t) {
+        for (std::size_t i = 0; i != v.size(); ++i) {
+            CPPUNIT_ASSERT(*v[i] == t);
+            x.deallocate(v[i], 1);}
+        v.clear();}
+
+    void test_remote_frees () {
+        A x;
+        std::vector<std::vector<pointer> > blocks(threads);
+        for (int k = 0; k != 3; ++k) {
+            std::vector<std::thread> v;
+            for (int t = 0; t != threads; ++t)
+                v.push_back(std::thread(fill, std::ref(x), std::ref(blocks[t]), t));
+            for (int t = 0; t != threads; ++t)
+                v[t].join();
+            v.clear();
+            for (int t = 0; t != threads; ++t)
+                v.push_back(std::thread(drain, std::ref(x), std::ref(blocks[(t + 1) % threads]), (t + 1) % threads));
+            for (int t = 0; t != threads; ++t)
+                v[t].join();
+            CPPUNIT_ASSERT(x.isValid());}}
+
+    // -----
+    // suite
+    // -----
+
+    CPPUNIT_TEST_SUITE(TestConcurrentAllocator);
+    CPPUNIT_TEST(test_churn);
+    CPPUNIT_TEST(test_remote_frees);
+    CPPUNIT_TEST_SUITE_END();};
+
+// -----------------
+// TestSlabAllocator
+// -----------------
+
+/**
+ * objects whose size isn't a multiple of an int's alignment, so that a slot of
+ * one of them can't hold the free-list link aligned
+ */
+struct Odd {
+    char c[5];
+    Odd (int v = 0) {
+        std::fill(c, c + 5, v);}
+    bool operator == (const Odd& that) const {
+        return std::equal(c, c + 5, that.c);}};
+
+struct Shorts {
+    short s[3];
+    Shorts (int v = 0) {
+        std::fill(s, s + 3, v);}
+    bool operator == (const Shorts& that) const {
+        return std::equal(s, s + 3, that.s);}};
+
+template <typename C>
+struct TestSlabAllocator : CppUnit::TestFixture {
+    typedef typename C::value_type value_type;
+    typedef typename C::pointer    pointer;
+
+    // ----------
+    // test_slots
+    // ----------
+
+    void test_slots () {
+        C x;
+        pointer p1 = x.allocate(1);
+        pointer p2 = x.allocate(1);
+        pointer p3 = x.allocate(1);
+        //no sentinels between neighbouring slots
+        CPPUNIT_ASSERT(reinterpret_cast<char*>(p2) - reinterpret_cast<char*>(p1) < 2*(int)sizeof(int) + (int)sizeof(value_type));
+        CPPUNIT_ASSERT(reinterpret_cast<char*>(p3) - reinterpret_cast<char*>(p2) == reinterpret_cast<char*>(p2) - reinterpret_cast<char*>(p1));
+        x.deallocate(p2, 1);
+        //the free stack hands back the last slot freed
+        CPPUNIT_ASSERT(x.allocate(1) == p2);
+        x.deallocate(p1, 1);
+        x.deallocate(p2, 1);
+        x.deallocate(p3, 1);
+        CPPUNIT_ASSERT(x.isValid());}
+
+    // -------------
+    // test_fallback
+    // -------------
+
+    void test_fallback () {
+        C x;
+        pointer p1 = x.allocate(1);
+        pointer p2 = x.allocate(3);
+        pointer p3 = x.allocate(1);
+        x.construct(p1, 1);
+        x.construct(p3, 3);
+        std::fill(p2, p2 + 3, 2);
+        CPPUNIT_ASSERT(*p1 == 1);
+        CPPUNIT_ASSERT(std::count(p2, p2 + 3, 2) == 3);
+        CPPUNIT_ASSERT(*p3 == 3);
+        x.deallocate(p2, 3);
+        x.deallocate(p1, 1);
+        x.deallocate(p3, 1);
+        CPPUNIT_ASSERT(x.isValid());}
+
+    // -------------
+    // test_exhaust
+    // -------------
+
+    void test_exhaust () {
+        C x;
+        std::vector<pointer> v;
+        try {
+            while (true)
+                v.push_back(x.allocate(1));}
+        catch (std::bad_alloc&) {}
+        CPPUNIT_ASSERT(!v.empty());
+        //more objects fit than on the boundary-tag path
+        CPPUNIT_ASSERT((int)v.size() > (100 - 2*(int)sizeof(int)) / (2*(int)sizeof(int) + (int)sizeof(value_type)));
+        for (std::size_t i = 0; i != v.size(); ++i)
+            x.deallocate(v[i], 1);
+        CPPUNIT_ASSERT(x.isValid());}
+
+    // -----
+    // suite
+    // -----
+
+    CPPUNIT_TEST_SUITE(TestSlabAllocator);
+    CPPUNIT_TEST(test_slots);
+    CPPUNIT_TEST(test_fallback);
+    CPPUNIT_TEST(test_exhaust);
+    CPPUNIT_TEST_SUITE_END();};
+
+// --------------------
+// TestAlignedAllocator
+// --------------------
+
+struct alignas(16) Vector4 {
+    float v[4];};
+
+struct alignas(64) CacheLine {
+    char c[64];};
+
+template <typename C>
+struct TestAlignedAllocator : CppUnit::TestFixture {
+    typedef typename C::value_type value_type;
+    typedef typename C::pointer    pointer;
+
+    static bool aligned (const void* p, std::size_t alignment) {
+        return reinterpret_cast<std::uintptr_t>(p) % alignment == 0;}
+
+    // ------------
+    // test_aligned
+    // ------------
+
+    void test_aligned () {
+        C x;
+        std::vector<pointer> v;
+        for (int n = 1; n != 4; ++n) {
+            v.push_back(x.allocate(n));
+            CPPUNIT_ASSERT(aligned(v.back(), alignof(value_type)));}
+        x.deallocate(v[1]);
+        v[1] = x.allocate(1);
+        CPPUNIT_ASSERT(aligned(v[1], alignof(value_type)));
+        for (std::size_t i = 0; i != v.size(); ++i)
+            x.deallocate(v[i]);
+        CPPUNIT_ASSERT(x.isValid());}
+
+    // --------------
+    // test_alignment
+    // --------------
+
+    void test_alignment () {
+        C x;
+        std::vector<pointer> v;
+        for (int k = 1; k <= 128; k *= 2) {
+            v.push_back(x.allocate(1, k));
+            CPPUNIT_ASSERT(aligned(v.back(), k));
+            CPPUNIT_ASSERT(aligned(v.back(), alignof(value_type)));}
+        for (std::size_t i = 0; i != v.size(); ++i)
+            x.deallocate(v[i]);
+        CPPUNIT_ASSERT(x.isValid());}
+
+    // ----------------------
+    // test_invalid_alignment
+    // ----------------------
+
+    void test_invalid_alignment () {
+        C x;
+        try {
+            x.allocate(1, 24);
+            CPPUNIT_ASSERT(false);}
+        catch (std::invalid_argument&) {}
+        CPPUNIT_ASSERT(x.isValid());}
+
+    // -----
+    // suite
+    // -----
+
+    CPPUNIT_TEST_SUITE(TestAlignedAllocator);
+    CPPUNIT_TEST(test_aligned);
+    CPPUNIT_TEST(test_alignment);
+    CPPUNIT_TEST(test_invalid_alignment);
+    CPPUNIT_TEST_SUITE_END();};
+
+// ------------------
+// TestArenaAllocator
+// ------------------
+
+struct TestArenaAllocator : CppUnit::TestFixture {
+    typedef Arena<4096>                 A;
+    typedef ArenaAllocator<int, 4096>   B;
+    typedef std::allocator_traits<B>    traits;
+
+    // ---------------
+    // test_equality
+    // ---------------
+
+    void test_equality () {
+        A a1;
+        A a2;
+        const B                            x(a1);
+        const B                            y(a1);
+        const B                            z(a2);
+        const ArenaAllocator<double, 4096> w(x);
+        CPPUNIT_ASSERT(x == y);
+        CPPUNIT_ASSERT(x != z);
+        CPPUNIT_ASSERT(x == w);
+        CPPUNIT_ASSERT(w != z);
+        CPPUNIT_ASSERT(a1 == a1);
+        CPPUNIT_ASSERT(a1 != a2);}
+
+    // -----------
+    // test_traits
+    // -----------
+
+    void test_traits () {
+        CPPUNIT_ASSERT((std::is_same<traits::rebind_alloc<double>, ArenaAllocator<double, 4096> >::value));
+        CPPUNIT_ASSERT(traits::propagate_on_container_copy_assignment::value);
+        CPPUNIT_ASSERT(traits::propagate_on_container_move_assignment::value);
+        CPPUNIT_ASSERT(traits::propagate_on_container_swap::value);
+        CPPUNIT_ASSERT(!traits::is_always_equal::value);
+        A a;
+        B x(a);
+        int* p = traits::allocate(x, 3);
+        traits::construct(x, p, 2);
+        CPPUNIT_ASSERT(*p == 2);
+        traits::destroy(x, p);
+        traits::deallocate(x, p, 3);
+        CPPUNIT_ASSERT(a.isValid());}
+
+    // ---------
+    // test_list
+    // ---------
+
+    void test_list () {
+        A a;
+        const int s = a.total_free();
+        {
+        std::list<int, B> x((B(a)));
+        for (int i = 0; i != 100; ++i)
+            x.push_back(i);
+        CPPUNIT_ASSERT(std::accumulate(x.begin(), x.end(), 0) == 4950);
+        CPPUNIT_ASSERT(a.total_free() < s);
+        }
+        CPPUNIT_ASSERT(a.total_free() == s);
+        CPPUNIT_ASSERT(a.isValid());}
+
+    // --------
+    // test_map
+    // --------
+
+    void test_map () {
+        A a;
+        const int s = a.total_free();
+        {
+        typedef ArenaAllocator<std::pair<const int, int>, 4096> C;
+        std::map<int, int, std::less<int>, C> x((C(a)));
+        for (int i = 0; i != 50; ++i)
+            x[i % 17] += i;
+        CPPUNIT_ASSERT(x.size() == 17);
+        CPPUNIT_ASSERT(x[3] == 3 + 20 + 37);
+        x.erase(3);
+        CPPUNIT_ASSERT(x.size() == 16);
+        }
+        CPPUNIT_ASSERT(a.total_free() == s);
+        CPPUNIT_ASSERT(a.isValid());}
+
+    // ------------------
+    // test_unordered_map
+    // ------------------
+
+    void test_unordered_map () {
+        A a;
+        const int s = a.total_free();
+        {
+        typedef ArenaAllocator<std::pair<const int, int>, 4096> C;
+        std::unordered_map<int, int, std::hash<int>, std::equal_to<int>, C> x(8, std::hash<int>(), std::equal_to<int>(), C(a));
+        for (int i = 0; i != 40; ++i)
+            x[i] = i * i;
+        CPPUNIT_ASSERT(x.size() == 40);
+        CPPUNIT_ASSERT(x[7] == 49);
+        }
+        CPPUNIT_ASSERT(a.total_free() == s);
+        CPPUNIT_ASSERT(a.isValid());}
+
+    // ---------
+    // test_swap
+    // ---------
+
+    void test_swap () {
+        A a1;
+        A a2;
+        std::vector<int, B> x(3, 1, B(a1));
+        std::vector<int, B> y(5, 2, B(a2));
+        x.swap(y);
+        CPPUNIT_ASSERT(x.get_allocator().arena() == &a2);
+        CPPUNIT_ASSERT(y.get_allocator().arena() == &a1);
+        CPPUNIT_ASSERT(std::count(x.begin(), x.end(), 2) == 5);}
+
+    // ---------
+    // test_pmr
+    // ---------
+
+    void test_pmr () {
+        A a;
+        const int s = a.total_free();
+        ArenaResource<4096> r(a);
+        {
+        std::pmr::vector<double> x(&r);
+        for (int i = 0; i != 20; ++i)
+            x.push_back(i);
+        std::pmr::map<int, std::pmr::string> y(&r);
+        y[1] = "one";
+        y[2] = "two";
+        CPPUNIT_ASSERT(x[19] == 19);
+        CPPUNIT_ASSERT(y[2] == "two");
+        CPPUNIT_ASSERT(a.total_free() < s);
+        }
+        CPPUNIT_ASSERT(a.total_free() == s);
+        CPPUNIT_ASSERT(r.is_equal(r));
+        A b;
+        ArenaResource<4096> q(b);
+        CPPUNIT_ASSERT(!r.is_equal(q));
+        CPPUNIT_ASSERT(a.isValid());}
+
+    // -----------------
+    // test_runtime_list
+    // -----------------
+
+    void test_runtime_list () {
+        Arena<0> a(1 << 16);
+        const int s = a.total_free();
+        {
+        typedef ArenaAllocator<int, 0> C;
+        CPPUNIT_ASSERT(C(a).max_size() == (std::size_t)a.capacity() / sizeof(int));
+        std::list<int, C> x((C(a)));
+        std::vector<int, C> y((C(a)));
+        for (int i = 0; i != 1000; ++i) {
+            x.push_back(i);
+            y.push_back(i);}
+        CPPUNIT_ASSERT(std::accumulate(x.begin(), x.end(), 0) == 499500);
+        CPPUNIT_ASSERT(std::accumulate(y.begin(), y.end(), 0) == 499500);
+        CPPUNIT_ASSERT(a.total_free() < s);
+        }
+        CPPUNIT_ASSERT(a.total_free() == s);
+        CPPUNIT_ASSERT(a.isValid());}
+
+    // ----------------
+    // test_runtime_pmr
+    // ----------------
+
+    void test_runtime_pmr () {
+        Arena<0> a(1 << 16);
+        const int s = a.total_free();
+        ArenaResource<0> r(a);
+        {
+        std::pmr::vector<double> x(&r);
+        for (int i = 0; i != 1000; ++i)
+            x.push_back(i);
+        std::pmr::map<int, std::pmr::string> y(&r);
+        y[1] = "a string too long to be stored in place";
+        CPPUNIT_ASSERT(x[999] == 999);
+        CPPUNIT_ASSERT(y[1].size() == 39);
+        CPPUNIT_ASSERT(a.total_free() < s);
+        }
+        CPPUNIT_ASSERT(a.total_free() == s);
+        CPPUNIT_ASSERT(a.isValid());}
+
+    // -----
+    // suite
+    // -----
+
+    CPPUNIT_TEST_SUITE(TestArenaAllocator);
+    CPPUNIT_TEST(test_equality);
+    CPPUNIT_TEST(test_traits);
+    CPPUNIT_TEST(test_list);
+    CPPUNIT_TEST(test_map);
+    CPPUNIT_TEST(test_unordered_map);
+    CPPUNIT_TEST(test_swap);
+    CPPUNIT_TEST(test_pmr);
+    CPPUNIT_TEST(test_runtime_list);
+    CPPUNIT_TEST(test_runtime_pmr);
+    CPPUNIT_TEST_SUITE_END();};
+
+// ---------------------
+// TestRuntimeAllocator
+// ---------------------
+
+struct TestRuntimeAllocator : CppUnit::TestFixture {
+
+    // -----------
+    // test_buffer
+    // -----------
+
+    void test_buffer () {
+        alignas(8) char b[257];
+        Allocator<double, 0> x(b + 1, 256);
+        double* p = x.allocate(4);
+        CPPUNIT_ASSERT(reinterpret_cast<std::uintptr_t>(p) % alignof(double) == 0);
+        CPPUNIT_ASSERT((b < reinterpret_cast<char*>(p)) && (reinterpret_cast<char*>(p + 4) <= b + 257));
+        x.deallocate(p);
+        CPPUNIT_ASSERT(x.empty());
+        CPPUNIT_ASSERT(x.isValid());}
+
+    void test_small_buffer () {
+        char b[4];
+        try {
+            Allocator<int, 0> x(b, 4);
+            CPPUNIT_ASSERT(false);}
+        catch (std::bad_alloc&) {}}
+
+    // -----------
+    // test_mapped
+    // -----------
+
+    void test_mapped () {
+        Allocator<int, 0> x(100000);
+        int* p = x.allocate(20000);
+        std::fill(p, p + 20000, 3);
+        CPPUNIT_ASSERT(x.owns(p));
+        CPPUNIT_ASSERT(x.owns(p + 19999));
+        x.deallocate(p);
+        x.trim();
+        //released pages come back as zeros, but the heap is intact
+        p = x.allocate(20000);
+        CPPUNIT_ASSERT(x.isValid());
+        x.deallocate(p);
+        CPPUNIT_ASSERT(x.empty());}
+
+    // ---------
+    // test_move
+    // ---------
+
+    void test_move () {
+        Allocator<int, 0> x(4096);
+        int* p = x.allocate(10);
+        Allocator<int, 0> y(std::move(x));
+        CPPUNIT_ASSERT(y.owns(p));
+        y.deallocate(p);
+        CPPUNIT_ASSERT(y.isValid());}
+
+    // ---------
+    // test_grow
+    // ---------
+
+    void test_grow () {
+        GrowableAllocator<int> x(4096);
+        std::vector<int*> v;
+        for (int i = 0; i != 2000; ++i) {
+            v.push_back(x.allocate(4));
+            std::fill(v.back(), v.back() + 4, i);}
+        CPPUNIT_ASSERT(x.chunks() > 1);
+        for (int i = 0; i != 2000; ++i)
+            CPPUNIT_ASSERT(std::count(v[i], v[i] + 4, i) == 4);
+        CPPUNIT_ASSERT(x.isValid());
+        for (int i = 0; i != 2000; ++i)
+            x.deallocate(v[i]);
+        //only the newest chunk is kept
+        CPPUNIT_ASSERT(x.chunks() == 1);
+        CPPUNIT_ASSERT(x.isValid());}
+
+    void test_grow_big () {
+        GrowableAllocator<double> x(4096);
+        double* p = x.allocate(100000);
+        p[99999] = 1;
+        double* q = x.allocate(1, 64);
+        CPPUNIT_ASSERT(reinterpret_cast<std::uintptr_t>(q) % 64 == 0);
+        x.deallocate(q);
+        x.deallocate(p);
+        CPPUNIT_ASSERT(x.isValid());}
+
+    // -----
+    // suite
+    // -----
+
+    CPPUNIT_TEST_SUITE(TestRuntimeAllocator);
+    CPPUNIT_TEST(test_buffer);
+    CPPUNIT_TEST(test_small_buffer);
+    CPPUNIT_TEST(test_mapped);
+    CPPUNIT_TEST(test_move);
+    CPPUNIT_TEST(test_grow);
+    CPPUNIT_TEST(test_grow_big);
+    CPPUNIT_TEST_SUITE_END();};
+
+// -------------
+// TestPlacement
+// -------------
+
+/**
+ * two holes in the same bin, the bigger one at the head of its list;
+ * returns whether the next request that fits both goes to the smaller one
+ */
+template <typename P>
+bool takes_smaller_hole () {
+    Allocator<int, 400, P> x;
+    int* a = x.allocate(6);
+    x.allocate(1);
+    int* b = x.allocate(5);
+    x.allocate(1);
+    x.deallocate(b);
+    x.deallocate(a);
+    return x.allocate(5) == b;}
+
+/**
+ * how many free blocks a padded request looks at before it fails, in a heap
+ * whose only free blocks are 20 holes too small for it
+ */
+template <typename P>
+long aligned_miss_scan () {
+    Allocator<char, 1000, P, Stats> x;
+    std::vector<char*> v;
+    for (int k = 0; k != 40; ++k)
+        v.push_back(x.allocate(8));
+    x.allocate(x.largest_free());
+    for (int k = 0; k < 40; k += 2)
+        x.deallocate(v[k]);
+    const long scans = x.stats().scans;
+    if (x.try_allocate(40, 64) != 0)
+        return -1;
+    return x.stats().scans - scans;}
+
+struct TestPlacement : CppUnit::TestFixture {
+
+    // -------------
+    // test_best_fit
+    // -------------
+
+    void test_best_fit () {
+        CPPUNIT_ASSERT(!takes_smaller_hole<FirstFit>());
+        CPPUNIT_ASSERT(takes_smaller_hole<BestFit>());
+        CPPUNIT_ASSERT(takes_smaller_hole<AddressOrderedBestFit>());}
+
+    // -----------------
+    // test_aligned_miss
+    // -----------------
+
+    void test_aligned_miss () {
+        //the holes aren't in the bins a padded request searches, so it
+        //fails without walking the heap
+        CPPUNIT_ASSERT(aligned_miss_scan<FirstFit>()              == 0);
+        CPPUNIT_ASSERT(aligned_miss_scan<BestFit>()               == 0);
+        CPPUNIT_ASSERT(aligned_miss_scan<AddressOrderedBestFit>() == 0);}
+
+    void test_address_ordered () {
+        Allocator<int, 400, AddressOrderedBestFit> x;
+        int* a = x.allocate(5);
+        x.allocate(1);
+        int* b = x.allocate(5);
+        x.allocate(1);
+        x.deallocate(a);
+        x.deallocate(b);
+        //b is at the head of the bin, but a is lower
+        CPPUNIT_ASSERT(x.allocate(5) == a);
+        CPPUNIT_ASSERT(x.isValid());}
+
+    // -------------
+    // test_next_fit
+    // -------------
+
+    void test_next_fit () {
+        Allocator<int, 100, NextFit> x;
+        int* a = x.allocate(2);
+        int* b = x.allocate(2);
+        x.deallocate(a);
+        //the walk picks up after b, not at a
+        int* c = x.allocate(2);
+        CPPUNIT_ASSERT(c > b);
+        x.allocate(x.largest_free() / sizeof(int));
+        //the heap is used up to the end, so the walk wraps around to a
+        CPPUNIT_ASSERT(x.allocate(2) == a);
+        CPPUNIT_ASSERT(x.isValid());}
+
+    void test_next_fit_coalesce () {
+        Allocator<int, 100, NextFit> x;
+        x.allocate(2);
+        int* b = x.allocate(2);
+        //the rover was at the block after b, which b now swallows
+        x.deallocate(b);
+        CPPUNIT_ASSERT(x.isValid());
+        CPPUNIT_ASSERT(x.allocate(2) == b);}
+
+    // ------------------
+    // test_fragmentation
+    // ------------------
+
+    void test_fragmentation () {
+        Allocator<int, 200> x;
+        CPPUNIT_ASSERT(x.fragmentation() == 0);
+        int* a = x.allocate(4);
+        int* b = x.allocate(1);
+        x.deallocate(a);
+        CPPUNIT_ASSERT((x.fragmentation() > 0) && (x.fragmentation() < 1));
+        x.deallocate(b);
+        CPPUNIT_ASSERT(x.fragmentation() == 0);
+        x.allocate(x.largest_free() / sizeof(int));
+        CPPUNIT_ASSERT(x.fragmentation() == 0);}
+
+    // -----
+    // suite
+    // -----
+
+    CPPUNIT_TEST_SUITE(TestPlacement);
+    CPPUNIT_TEST(test_best_fit);
+    CPPUNIT_TEST(test_aligned_miss);
+    CPPUNIT_TEST(test_address_ordered);
+    CPPUNIT_TEST(test_next_fit);
+    CPPUNIT_TEST(test_next_fit_coalesce);
+    CPPUNIT_TEST(test_fragmentation);
+    CPPUNIT_TEST_SUITE_END();};
+
+// ---------
+// TestStats
+// ---------
+
+/**
+ * the hook for test_hook: keeps what it's told
+ */
+void record (void* context, AllocatorEvent e, const void*, long bytes) {
+    static_cast<std::vector<std::pair<AllocatorEvent, long> >*>(context)->push_back(std::make_pair(e, bytes));}
+
+struct TestStats : CppUnit::TestFixture {
+    typedef Allocator<int, 100, FirstFit, Stats> A;
+
+    // ----------
+    // test_fresh
+    // ----------
+
+    void test_fresh () {
+        const A x;
+        const AllocatorStats s = x.stats();
+        CPPUNIT_ASSERT(s.allocs       == 0);
+        CPPUNIT_ASSERT(s.bytes_in_use == 0);
+        CPPUNIT_ASSERT(s.free_blocks  == 1);
+        CPPUNIT_ASSERT(s.largest_free == 92);
+        CPPUNIT_ASSERT(std::accumulate(s.sizes, s.sizes + 32, 0L) == 0);}
+
+    // -------------
+    // test_counters
+    // -------------
+
+    void test_counters () {
+        A x;
+        int* p = x.allocate(5);
+        int* q = x.allocate(2);
+        AllocatorStats s = x.stats();
+        CPPUNIT_ASSERT(s.allocs       == 2);
+        CPPUNIT_ASSERT(s.bytes_in_use == 28);
+        CPPUNIT_ASSERT(s.free_blocks  == 1);
+        CPPUNIT_ASSERT(s.sizes[4]     == 1);
+        CPPUNIT_ASSERT(s.sizes[3]     == 1);
+        CPPUNIT_ASSERT(s.scans        >= 2);
+        CPPUNIT_ASSERT(s.max_scan     >= 1);
+        x.deallocate(p);
+        s = x.stats();
+        CPPUNIT_ASSERT(s.frees        == 1);
+        CPPUNIT_ASSERT(s.bytes_in_use == 8);
+        CPPUNIT_ASSERT(s.high_water   == 28);
+        CPPUNIT_ASSERT(s.free_blocks  == 2);
+        try {
+            x.allocate(1000);
+            CPPUNIT_ASSERT(false);}
+        catch (std::bad_alloc&) {}
+        CPPUNIT_ASSERT(x.counts().failures  == 1);
+        CPPUNIT_ASSERT(x.counts().sizes[11] == 1);
+        //q has free blocks on both sides
+        x.deallocate(q);
+        s = x.stats();
+        CPPUNIT_ASSERT(s.bytes_in_use == 0);
+        CPPUNIT_ASSERT(s.free_blocks  == 1);
+        CPPUNIT_ASSERT(s.largest_free == 92);}
+
+    void test_padding () {
+        Allocator<char, 1000, FirstFit, Stats> x;
+        x.allocate(1);
+        char* p = x.allocate(1, 64);
+        CPPUNIT_ASSERT(x.stats().free_blocks == 2);
+        x.deallocate(p);
+        CPPUNIT_ASSERT(x.stats().free_blocks == 1);
+        CPPUNIT_ASSERT(x.isValid());}
+
+    void test_copy () {
+        A x;
+        x.allocate(5);
+        const A y = x;
+        CPPUNIT_ASSERT(y.stats().allocs       == 1);
+        CPPUNIT_ASSERT(y.stats().bytes_in_use == 20);}
+
+    // ---------
+    // test_hook
+    // ---------
+
+    void test_hook () {
+        std::vector<std::pair<AllocatorEvent, long> > v;
+        A x;
+        x.hook(record, &v);
+        int* p = x.allocate(3);
+        x.deallocate(p);
+        try {
+            x.allocate(1000);}
+        catch (std::bad_alloc&) {}
+        x.hook(0, 0);
+        x.allocate(1);
+        CPPUNIT_ASSERT(v.size() == 3);
+        CPPUNIT_ASSERT(v[0] == std::make_pair(ALLOCATED,   12L));
+        CPPUNIT_ASSERT(v[1] == std::make_pair(DEALLOCATED, 12L));
+        CPPUNIT_ASSERT(v[2] == std::make_pair(FAILED,      4000L));}
+
+    // -----
+    // suite
+    // -----
+
+    CPPUNIT_TEST_SUITE(TestStats);
+    CPPUNIT_TEST(test_fresh);
+    CPPUNIT_TEST(test_counters);
+    CPPUNIT_TEST(test_padding);
+    CPPUNIT_TEST(test_copy);
+    CPPUNIT_TEST(test_hook);
+    CPPUNIT_TEST_SUITE_END();};
+
+// --------------
+// TestReallocate
+// --------------
+
+struct TestReallocate : CppUnit::TestFixture {
+    typedef Allocator<int, 100, FirstFit, Stats> A;
+
+    // ---------------
+    // test_try_expand
+    // ---------------
+
+    void test_try_expand () {
+        A x;
+        int* p = x.allocate(2);
+        p[1] = 7;
+        CPPUNIT_ASSERT(x.try_expand(p, 2, 10));
+        CPPUNIT_ASSERT(x.block_size(p) == 40);
+        CPPUNIT_ASSERT(p[1] == 7);
+        CPPUNIT_ASSERT(x.stats().bytes_in_use == 40);
+        CPPUNIT_ASSERT(x.stats().free_blocks  == 1);
+        CPPUNIT_ASSERT(x.isValid());}
+
+    void test_try_expand_blocked () {
+        A x;
+        int* p = x.allocate(2);
+        x.allocate(2);
+        CPPUNIT_ASSERT(!x.try_expand(p, 2, 3));
+        CPPUNIT_ASSERT(x.block_size(p) == 8);
+        CPPUNIT_ASSERT(x.isValid());}
+
+    void test_try_expand_whole () {
+        A x;
+        int* p = x.allocate(2);
+        int* q = x.allocate(2);
+        x.allocate(2);
+        x.deallocate(q);
+        //what's left of q's block couldn't be a block of its own
+        CPPUNIT_ASSERT(x.try_expand(p, 2, 4));
+        CPPUNIT_ASSERT(x.block_size(p) == 24);
+        CPPUNIT_ASSERT(x.stats().free_blocks == 1);
+        CPPUNIT_ASSERT(x.isValid());}
+
+    void test_try_expand_rover () {
+        Allocator<int, 100, NextFit> x;
+        int* p = x.allocate(2);
+        //the rover is at the free block p grows into
+        CPPUNIT_ASSERT(x.try_expand(p, 2, 4));
+        CPPUNIT_ASSERT(x.isValid());
+        CPPUNIT_ASSERT(x.allocate(1) == p + 6);}
+
+    // --------------------
+    // test_shrink_in_place
+    // --------------------
+
+    void test_shrink_in_place () {
+        A x;
+        int* p = x.allocate(10);
+        //the rest of the heap goes to the second block
+        x.allocate(10);
+        x.shrink_in_place(p, 10, 2);
+        CPPUNIT_ASSERT(x.block_size(p) == 8);
+        CPPUNIT_ASSERT(x.stats().free_blocks == 1);
+        CPPUNIT_ASSERT(x.allocate(6) == p + 4);
+        CPPUNIT_ASSERT(x.isValid());}
+
+    void test_shrink_in_place_merge () {
+        A x;
+        int* p = x.allocate(10);
+        x.shrink_in_place(p, 10, 2);
+        CPPUNIT_ASSERT(x.stats().free_blocks  == 1);
+        CPPUNIT_ASSERT(x.stats().bytes_in_use == 8);
+        CPPUNIT_ASSERT(x.largest_free() == 76);
+        CPPUNIT_ASSERT(x.isValid());}
+
+    // ---------------
+    // test_reallocate
+    // ---------------
+
+    void test_reallocate () {
+        A x;
+        int* p = x.reallocate(0, 0, 2);
+        p[0] = 1;
+        p[1] = 2;
+        x.allocate(2);
+        //p can't grow in place, so it moves
+        int* q = x.reallocate(p, 2, 5);
+        CPPUNIT_ASSERT(q != p);
+        CPPUNIT_ASSERT((q[0] == 1) && (q[1] == 2));
+        //and then it can
+        CPPUNIT_ASSERT(x.reallocate(q, 5, 8) == q);
+        CPPUNIT_ASSERT(x.reallocate(q, 8, 1) == q);
+        CPPUNIT_ASSERT(q[0] == 1);
+        CPPUNIT_ASSERT(x.reallocate(q, 1, 0) == 0);
+        CPPUNIT_ASSERT(x.stats().frees == 2);
+        CPPUNIT_ASSERT(x.isValid());}
+
+    void test_reallocate_bad_alloc () {
+        A x;
+        int* p = x.allocate(2);
+        p[1] = 3;
+        x.allocate(2);
+        try {
+            x.reallocate(p, 2, 100);
+            CPPUNIT_ASSERT(false);}
+        catch (std::bad_alloc&) {}
+        CPPUNIT_ASSERT(p[1] == 3);
+        CPPUNIT_ASSERT(x.block_size(p) == 8);
+        CPPUNIT_ASSERT(x.isValid());}
+
+    void test_reallocate_too_big () {
+        A x;
+        int* p = x.allocate(3);
+        p[2] = 5;
+        //bytes_for(new_n) would overflow, and must not pass for a fit
+        CPPUNIT_ASSERT(!x.try_expand(p, 3, std::numeric_limits<int>::max()));
+        CPPUNIT_ASSERT(!x.try_expand(p, 3, -1));
+        try {
+            x.reallocate(p, 3, std::numeric_limits<int>::max() / 2);
+            CPPUNIT_ASSERT(false);}
+        catch (std::bad_alloc&) {}
+        CPPUNIT_ASSERT(p[2] == 5);
+        CPPUNIT_ASSERT(x.block_size(p) == 12);
+        CPPUNIT_ASSERT(x.isValid());}
+
+    // -----
+    // suite
+    // -----
+
+    CPPUNIT_TEST_SUITE(TestReallocate);
+    CPPUNIT_TEST(test_try_expand);
+    CPPUNIT_TEST(test_try_expand_blocked);
+    CPPUNIT_TEST(test_try_expand_whole);
+    CPPUNIT_TEST(test_try_expand_rover);
+    CPPUNIT_TEST(test_shrink_in_place);
+    CPPUNIT_TEST(test_shrink_in_place_merge);
+    CPPUNIT_TEST(test_reallocate);
+    CPPUNIT_TEST(test_reallocate_bad_alloc);
+    CPPUNIT_TEST(test_reallocate_too_big);
+    CPPUNIT_TEST_SUITE_END();};
+
+// ---------
+// TestBatch
+// ---------
+
+struct TestBatch : CppUnit::TestFixture {
+    typedef Allocator<int, 200, FirstFit, Stats> A;
+
+    // -------------------
+    // test_allocate_batch
+    // -------------------
+
+    void test_allocate_batch () {
+        A x;
+        int* v[5];
+        x.allocate_batch(5, 2, v);
+        //side by side, 2 ints and 2 sentinels apart
+        for (int i = 1; i != 5; ++i)
+            CPPUNIT_ASSERT(v[i] == v[i - 1] + 4);
+        CPPUNIT_ASSERT(x.stats().allocs       == 5);
+        CPPUNIT_ASSERT(x.stats().bytes_in_use == 40);
+        CPPUNIT_ASSERT(x.stats().free_blocks  == 1);
+        CPPUNIT_ASSERT(x.isValid());}
+
+    void test_allocate_batch_holes () {
+        A x;
+        int* p = x.allocate(6);
+        x.allocate(1);
+        x.deallocate(p);
+        int* v[10];
+        //two fill p's old block, and the rest go after
+        x.allocate_batch(10, 1, v);
+        CPPUNIT_ASSERT(v[0] == p);
+        CPPUNIT_ASSERT(v[2] > p + 6);
+        CPPUNIT_ASSERT(x.isValid());}
+
+    void test_allocate_batch_bad_alloc () {
+        A x;
+        int* v[20];
+        try {
+            x.allocate_batch(20, 4, v);
+            CPPUNIT_ASSERT(false);}
+        catch (std::bad_alloc&) {}
+        CPPUNIT_ASSERT(x.empty());
+        CPPUNIT_ASSERT(x.stats().bytes_in_use == 0);
+        CPPUNIT_ASSERT(x.isValid());}
+
+    void test_allocate_batch_aligned () {
+        Allocator<Vector4, 1000> x;
+        Vector4* v[5];
+        x.allocate_batch(5, 1, v);
+        for (int i = 0; i != 5; ++i)
+            CPPUNIT_ASSERT(reinterpret_cast<std::uintptr_t>(v[i]) % alignof(Vector4) == 0);
+        x.deallocate_batch(v, 5);
+        CPPUNIT_ASSERT(x.isValid());}
+
+    // ---------------------
+    // test_deallocate_batch
+    // ---------------------
+
+    void test_deallocate_batch () {
+        A x;
+        int* v[8];
+        x.allocate_batch(8, 3, v);
+        std::swap(v[0], v[5]);
+        std::swap(v[2], v[7]);
+        x.deallocate_batch(v, 8);
+        CPPUNIT_ASSERT(x.empty());
+        CPPUNIT_ASSERT(x.stats().frees       == 8);
+        CPPUNIT_ASSERT(x.stats().free_blocks == 1);
+        CPPUNIT_ASSERT(x.isValid());}
+
+    void test_deallocate_batch_runs () {
+        A x;
+        int* v[6];
+        x.allocate_batch(6, 2, v);
+        int* w[] = {v[5], v[0], v[1]};
+        x.deallocate_batch(w, 3);
+        //v[0, 2) is one free block, and v[5] joins the free tail
+        CPPUNIT_ASSERT(x.stats().free_blocks == 2);
+        CPPUNIT_ASSERT(x.allocate(6) == v[0]);
+        CPPUNIT_ASSERT(x.isValid());}
+
+    // ----------------
+    // test_release_all
+    // ----------------
+
+    void test_release_all () {
+        A x;
+        int* v[5];
+        x.allocate_batch(5, 2, v);
+        x.allocate(7);
+        x.release_all();
+        CPPUNIT_ASSERT(x.empty());
+        CPPUNIT_ASSERT(x.stats().bytes_in_use == 0);
+        CPPUNIT_ASSERT(x.stats().free_blocks  == 1);
+        CPPUNIT_ASSERT(x.stats().frees        == 0);
+        CPPUNIT_ASSERT(x.isValid());}
+
+    // -----
+    // suite
+    // -----
+
+    CPPUNIT_TEST_SUITE(TestBatch);
+    CPPUNIT_TEST(test_allocate_batch);
+    CPPUNIT_TEST(test_allocate_batch_holes);
+    CPPUNIT_TEST(test_allocate_batch_bad_alloc);
+    CPPUNIT_TEST(test_allocate_batch_aligned);
+    CPPUNIT_TEST(test_deallocate_batch);
+    CPPUNIT_TEST(test_deallocate_batch_runs);
+    CPPUNIT_TEST(test_release_all);
+    CPPUNIT_TEST_SUITE_END();};
+
+// --------------------
+// TestCompactAllocator
+// --------------------
+
+struct TestCompactAllocator : CppUnit::TestFixture {
+
+    // ---------
+    // test_word
+    // ---------
+
+    void test_word () {
+        CPPUNIT_ASSERT(sizeof(CompactAllocator<int, 100>::word)     == 2);
+        CPPUNIT_ASSERT(sizeof(CompactAllocator<int, 1 << 20>::word) == 4);
+        CPPUNIT_ASSERT(sizeof(CompactAllocator<int, 0>::word)       == 8);
+        CPPUNIT_ASSERT((CompactAllocator<int, 100>::overhead())     == 2);}
+
+    // ------------
+    // test_density
+    // ------------
+
+    void test_density () {
+        CompactAllocator<int, 1000> x;
+        Allocator<int, 1000>        y;
+        int m = 0;
+        int n = 0;
+        try {
+            for (;; ++m)
+                x.allocate(1);}
+        catch (std::bad_alloc&) {}
+        try {
+            for (;; ++n)
+                y.allocate(1);}
+        catch (std::bad_alloc&) {}
+        //8 bytes a block against 12
+        CPPUNIT_ASSERT(m == 124);
+        CPPUNIT_ASSERT(n == 83);
+        CPPUNIT_ASSERT(x.isValid());}
+
+    void test_block_size () {
+        CompactAllocator<int, 100> x;
+        int* p = x.allocate(1);
+        int* q = x.allocate(3);
+        CPPUNIT_ASSERT(x.block_size(p) == 6);
+        CPPUNIT_ASSERT(x.block_size(q) == 14);
+        CPPUNIT_ASSERT(reinterpret_cast<char*>(q) == reinterpret_cast<char*>(p) + 8);}
+
+    // -------------
+    // test_coalesce
+    // -------------
+
+    void test_coalesce () {
+        CompactAllocator<double, 200> x;
+        double* p = x.allocate(2);
+        double* q = x.allocate(2);
+        double* r = x.allocate(2);
+        x.deallocate(q);
+        CPPUNIT_ASSERT(x.isValid());
+        x.deallocate(p);
+        CPPUNIT_ASSERT(x.isValid());
+        x.deallocate(r);
+        CPPUNIT_ASSERT(x.empty());
+        CPPUNIT_ASSERT(x.isValid());
+        CPPUNIT_ASSERT(x.allocate(2) == p);}
+
+    void test_bad_alloc () {
+        CompactAllocator<int, 100> x;
+        try {
+            x.allocate(100);
+            CPPUNIT_ASSERT(false);}
+        catch (std::bad_alloc&) {}
+        CPPUNIT_ASSERT(x.empty());}
+
+    // -----------
+    // test_buffer
+    // -----------
+
+    void test_buffer () {
+        alignas(8) char b[257];
+        CompactAllocator<double, 0> x(b + 1, 256);
+        double* p = x.allocate(4);
+        CPPUNIT_ASSERT(reinterpret_cast<std::uintptr_t>(p) % alignof(double) == 0);
+        CPPUNIT_ASSERT(x.owns(p));
+        x.deallocate(p);
+        CPPUNIT_ASSERT(x.empty());}
+
+    void test_big () {
+        //past what an int can count; only the pages touched are backed, but
+        //with overcommit off (vm.overcommit_memory=2) the mapping itself can
+        //fail, and then there's no heap to test
+        std::unique_ptr< CompactAllocator<char, 0> > h;
+        try {
+            h.reset(new CompactAllocator<char, 0>(std::size_t(3) << 30));}
+        catch (std::bad_alloc&) {
+            return;}
+        CompactAllocator<char, 0>& x = *h;
+        char* p = x.allocate(std::size_t(5) << 29);
+        p[(std::size_t(5) << 29) - 1] = 1;
+        CPPUNIT_ASSERT(x.block_size(p) >= (std::size_t(5) << 29));
+        char* q = x.allocate(100);
+        CPPUNIT_ASSERT(x.owns(q));
+        x.deallocate(p);
+        x.deallocate(q);
+        CPPUNIT_ASSERT(x.empty());
+        CPPUNIT_ASSERT(x.isValid());}
+
+    // -----
+    // suite
+    // -----
+
+    CPPUNIT_TEST_SUITE(TestCompactAllocator);
+    CPPUNIT_TEST(test_word);
+    CPPUNIT_TEST(test_density);
+    CPPUNIT_TEST(test_block_size);
+    CPPUNIT_TEST(test_coalesce);
+    CPPUNIT_TEST(test_bad_alloc);
+    CPPUNIT_TEST(test_buffer);
+    CPPUNIT_TEST(test_big);
+    CPPUNIT_TEST_SUITE_END();};
+
+// ---------
+// TestTrace
+// ---------
+
+struct TestTrace : CppUnit::TestFixture {
+    typedef Allocator<int, 100, FirstFit, Stats> A;
+
+    // -----------
+    // test_record
+    // -----------
+
+    void test_record () {
+        A x;
+        TraceRecorder r(16, &x);
+        x.hook(TraceRecorder::record, &r);
+        int* p = x.allocate(5);
+        int* q = x.allocate(2);
+        x.deallocate(p);
+        try {
+            x.allocate(1000);
+            CPPUNIT_ASSERT(false);}
+        catch (std::bad_alloc&) {}
+        CPPUNIT_ASSERT(r.size()    == 4);
+        CPPUNIT_ASSERT(r.dropped() == 0);
+        CPPUNIT_ASSERT(r[0].op     == ALLOCATED);
+        CPPUNIT_ASSERT(r[0].bytes  == 20);
+        CPPUNIT_ASSERT(r[1].bytes  == 8);
+        CPPUNIT_ASSERT(r[1].id     == std::uint64_t((char*)q - (char*)&x));
+        CPPUNIT_ASSERT(r[2].op     == DEALLOCATED);
+        CPPUNIT_ASSERT(r[2].id     == r[0].id);
+        CPPUNIT_ASSERT(r[3].op     == FAILED);
+        CPPUNIT_ASSERT(r[3].id     == 0);
+        CPPUNIT_ASSERT(r[0].nanos  <= r[3].nanos);
+        r.add(RESIZED, q, 5L << 30);
+        CPPUNIT_ASSERT(r[4].bytes  == std::uint64_t(5) << 30);}
+
+    // ---------
+    // test_ring
+    // ---------
+
+    void test_ring () {
+        A x;
+        TraceRecorder r(3, &x);
+        x.hook(TraceRecorder::record, &r);
+        for (int k = 1; k != 6; ++k)
+            x.deallocate(x.allocate(k));
+        CPPUNIT_ASSERT(r.size()    == 3);
+        CPPUNIT_ASSERT(r.dropped() == 7);
+        CPPUNIT_ASSERT(r[0].op     == DEALLOCATED);
+        CPPUNIT_ASSERT(r[1].op     == ALLOCATED);
+        CPPUNIT_ASSERT(r[1].bytes  == 20);
+        CPPUNIT_ASSERT(r[2].op     == DEALLOCATED);
+        x.release_all();
+        CPPUNIT_ASSERT(r[2].op     == RELEASED);
+        r.clear();
+        CPPUNIT_ASSERT(r.size()    == 0);}
+
+    // ---------
+    // test_save
+    // ---------
+
+    void test_save () {
+        A x;
+        TraceRecorder r(4, &x);
+        x.hook(TraceRecorder::record, &r);
+        int* p = x.allocate(3);
+        CPPUNIT_ASSERT(x.try_expand(p, 3, 6));
+        x.deallocate(p);
+        x.deallocate(x.allocate(1));
+        x.allocate(2);
+        const char* path = "TestAllocator.trace";
+        CPPUNIT_ASSERT(r.save(path));
+        std::vector<TraceRecord> v;
+        TraceHeader              h;
+        CPPUNIT_ASSERT(TraceRecorder::load(path, v, h));
+        std::remove(path);
+        CPPUNIT_ASSERT(h.count   == 4);
+        CPPUNIT_ASSERT(h.dropped == 2);
+        CPPUNIT_ASSERT(v.size()  == 4);
+        for (int k = 0; k != 4; ++k) {
+            CPPUNIT_ASSERT(v[k].op    == r[k].op);
+            CPPUNIT_ASSERT(v[k].id    == r[k].id);
+            CPPUNIT_ASSERT(v[k].nanos == r[k].nanos);}
+        CPPUNIT_ASSERT(v[0].op    == DEALLOCATED);
+        CPPUNIT_ASSERT(v[0].bytes == 24);
+        CPPUNIT_ASSERT(v[3].op    == ALLOCATED);
+        CPPUNIT_ASSERT(!TraceRecorder::load("TestAllocator.none", v, h));}
+
+    // ----------
+    // test_short
+    // ----------
+
+    void test_short () {
+        A x;
+        TraceRecorder r(4, &x);
+        x.hook(TraceRecorder::record, &r);
+        x.deallocate(x.allocate(1));
+        const char* path = "TestAllocator.trace";
+        CPPUNIT_ASSERT(r.save(path));
+        std::vector<TraceRecord> v;
+        TraceHeader              h;
+        CPPUNIT_ASSERT(TraceRecorder::load(path, v, h));
+        CPPUNIT_ASSERT(v.size() == 2);
+        h.count = std::uint64_t(1) << 60;
+        std::FILE* f = std::fopen(path, "r+b");
+        CPPUNIT_ASSERT(f != 0);
+        CPPUNIT_ASSERT(std::fwrite(&h, sizeof(h), 1, f) == 1);
+        std::fclose(f);
+        CPPUNIT_ASSERT(!TraceRecorder::load(path, v, h));
+        CPPUNIT_ASSERT(v.empty());
+        f = std::fopen(path, "wb");
+        CPPUNIT_ASSERT(f != 0);
+        CPPUNIT_ASSERT(std::fwrite(&h, sizeof(h) - 1, 1, f) == 1);
+        std::fclose(f);
+        CPPUNIT_ASSERT(!TraceRecorder::load(path, v, h));
+        std::remove(path);}
+
+    // -----
+    // suite
+    // -----
+
+    CPPUNIT_TEST_SUITE(TestTrace);
+    CPPUNIT_TEST(test_record);
+    CPPUNIT_TEST(test_ring);
+    CPPUNIT_TEST(test_save);
+    CPPUNIT_TEST(test_short);
+    CPPUNIT_TEST_SUITE_END();};
+
+// -------------------
+// TestBitmapAllocator
+// -------------------
+
+struct TestBitmapAllocator : CppUnit::TestFixture {
+    typedef BitmapAllocator<int, 100> A;
+
+    // ---------------
+    // test_fixed_size
+    // ---------------
+
+    void test_fixed_size () {
+        CPPUNIT_ASSERT(A::slots == 25);
+        CPPUNIT_ASSERT((BitmapAllocator<char, 64>::slots) == 64);
+        CPPUNIT_ASSERT((std::is_same<FixedAllocator<int, 100>,    A>::value));
+        CPPUNIT_ASSERT((std::is_same<FixedAllocator<char, 100>,   Allocator<char, 100> >::value));
+        CPPUNIT_ASSERT((std::is_same<FixedAllocator<double, 512>, BitmapAllocator<double, 512> >::value));
+        constexpr int b = Allocator<int, 100>::bytes_for(3);
+        CPPUNIT_ASSERT(b == 12);
+        CPPUNIT_ASSERT(sizeof(Allocator<int, 100>) < sizeof(Allocator<int, 0>) + 100);}
+
+    // ---------
+    // test_runs
+    // ---------
+
+    void test_runs () {
+        A x;
+        int* p = x.allocate(3);
+        int* q = x.allocate(1);
+        int* r = x.allocate(2);
+        CPPUNIT_ASSERT(q == p + 3);
+        CPPUNIT_ASSERT(r == p + 4);
+        CPPUNIT_ASSERT(x.block_size(p) == 12);
+        CPPUNIT_ASSERT(x.block_size(q) == 4);
+        x.deallocate(p);
+        CPPUNIT_ASSERT(x.allocate(2) == p);
+        CPPUNIT_ASSERT(x.allocate(2) == r + 2);
+        CPPUNIT_ASSERT(x.allocate(1) == p + 2);
+        CPPUNIT_ASSERT(x.total_free()   == 4 * 17);
+        CPPUNIT_ASSERT(x.largest_free() == 4 * 17);
+        CPPUNIT_ASSERT(x.isValid());}
+
+    // -------------
+    // test_adjacent
+    // -------------
+
+    void test_adjacent () {
+        A x;
+        int* p = x.allocate(2);
+        int* q = x.allocate(2);
+        CPPUNIT_ASSERT(x.block_size(p) == 8);
+        x.deallocate(q);
+        CPPUNIT_ASSERT(x.block_size(p) == 8);
+        x.deallocate(p);
+        CPPUNIT_ASSERT(x.empty());
+        CPPUNIT_ASSERT(x.fragmentation() == 0);}
+
+    // --------------
+    // test_bad_alloc
+    // --------------
+
+    void test_bad_alloc () {
+        A x;
+        std::vector<int*> v;
+        for (int i = 0; i != 25; ++i)
+            v.push_back(x.allocate(1));
+        try {
+            x.allocate(1);
+            CPPUNIT_ASSERT(false);}
+        catch (std::bad_alloc&) {}
+        for (int i = 0; i < 25; i += 2)
+            x.deallocate(v[i]);
+        CPPUNIT_ASSERT(x.largest_free() == 4);
+        CPPUNIT_ASSERT(x.fragmentation() > 0.9);
+        try {
+            x.allocate(2);
+            CPPUNIT_ASSERT(false);}
+        catch (std::bad_alloc&) {}
+        try {
+            x.allocate(26);
+            CPPUNIT_ASSERT(false);}
+        catch (std::bad_alloc&) {}
+        CPPUNIT_ASSERT(x.isValid());}
+
+    // -------------
+    // test_64_slots
+    // -------------
+
+    void test_64_slots () {
+        BitmapAllocator<char, 64> x;
+        char* p = x.allocate(64);
+        CPPUNIT_ASSERT(x.block_size(p) == 64);
+        x.deallocate(p);
+        char* q = x.allocate(63);
+        char* r = x.allocate(1);
+        CPPUNIT_ASSERT(r == q + 63);
+        CPPUNIT_ASSERT(x.block_size(r) == 1);
+        CPPUNIT_ASSERT(x.block_size(q) == 63);
+        x.deallocate(r);
+        x.deallocate(q);
+        CPPUNIT_ASSERT(x.empty());
+        CPPUNIT_ASSERT(x.isValid());}
+
+    // -----
+    // suite
+    // -----
+
+    CPPUNIT_TEST_SUITE(TestBitmapAllocator);
+    CPPUNIT_TEST(test_fixed_size);
+    CPPUNIT_TEST(test_runs);
+    CPPUNIT_TEST(test_adjacent);
+    CPPUNIT_TEST(test_bad_alloc);
+    CPPUNIT_TEST(test_64_slots);
     CPPUNIT_TEST_SUITE_END();};
 
-    
 // ----
 // main
 // ----
@@ -302,6 +1790,54 @@ int main () {
 
 	tr.addTest(TestAllocator2<Allocator<int, 100>>::suite());
 	tr.addTest(TestAllocator2<Allocator<char, 100>>::suite());
+
+    tr.addTest(TestAllocator< ConcurrentAllocator<int, 1000> >::suite());
+    tr.addTest(TestConcurrentAllocator::suite());
+
+    tr.addTest(TestAllocator< SlabAllocator<int, 100> >::suite());
+    tr.addTest(TestAllocator< SlabAllocator<double, 100> >::suite());
+    tr.addTest(TestSlabAllocator< SlabAllocator<int, 100> >::suite());
+    tr.addTest(TestSlabAllocator< SlabAllocator<char, 100> >::suite());
+    tr.addTest(TestSlabAllocator< SlabAllocator<Odd, 200> >::suite());
+    tr.addTest(TestSlabAllocator< SlabAllocator<Shorts, 200> >::suite());
+
+    tr.addTest(TestAlignedAllocator< Allocator<char, 1000> >::suite());
+    tr.addTest(TestAlignedAllocator< Allocator<double, 1000> >::suite());
+    tr.addTest(TestAlignedAllocator< Allocator<Vector4, 1000> >::suite());
+    tr.addTest(TestAlignedAllocator< Allocator<CacheLine, 2000> >::suite());
+
+    tr.addTest(TestArenaAllocator::suite());
+
+    tr.addTest(TestAllocator< GrowableAllocator<int> >::suite());
+    tr.addTest(TestAllocator< GrowableAllocator<double> >::suite());
+    tr.addTest(TestRuntimeAllocator::suite());
+
+    tr.addTest(TestAllocator< Allocator<int, 100, NextFit> >::suite());
+    tr.addTest(TestAllocator< Allocator<double, 100, BestFit> >::suite());
+    tr.addTest(TestAllocator< Allocator<int, 100, AddressOrderedBestFit> >::suite());
+    tr.addTest(TestAllocator2< Allocator<int, 100, BestFit> >::suite());
+    tr.addTest(TestAllocator2< Allocator<char, 100, AddressOrderedBestFit> >::suite());
+    tr.addTest(TestAlignedAllocator< Allocator<double, 1000, NextFit> >::suite());
+    tr.addTest(TestAlignedAllocator< Allocator<Vector4, 1000, BestFit> >::suite());
+    tr.addTest(TestPlacement::suite());
+
+    tr.addTest(TestAllocator< Allocator<int, 100, FirstFit, Stats> >::suite());
+    tr.addTest(TestAllocator2< Allocator<int, 100, BestFit, Stats> >::suite());
+    tr.addTest(TestStats::suite());
+    tr.addTest(TestReallocate::suite());
+    tr.addTest(TestBatch::suite());
+
+    tr.addTest(TestAllocator< CompactAllocator<int, 100> >::suite());
+    tr.addTest(TestAllocator< CompactAllocator<double, 100> >::suite());
+    tr.addTest(TestAllocator< CompactAllocator<int, 1 << 20> >::suite());
+    tr.addTest(TestCompactAllocator::suite());
+
+    tr.addTest(TestTrace::suite());
+
+    tr.addTest(TestAllocator< BitmapAllocator<int, 100> >::suite());
+    tr.addTest(TestAllocator< BitmapAllocator<double, 100> >::suite());
+    tr.addTest(TestAllocator< FixedAllocator<char, 1000> >::suite());
+    tr.addTest(TestBitmapAllocator::suite());
 	
     tr.run();
 